@@ -1,55 +1,166 @@
 #include <stdio.h>
+#include <ctype.h>
+#include <stdatomic.h>
 #include <rz_types.h>
 #include <rz_list.h>
+#include <rz_th.h>
 #include <rz_util/rz_file.h>
+#include <rz_util/rz_str.h>
+#include <rz_util/rz_time.h>
 #include <tree_sitter/api.h>
 
 #include <types_parser.h>
+#include <types_db.h>
+#include <types_lib.h>
+#include <types_store.h>
 
 // Declare the `tree_sitter_c` function, which is
 // implemented by the `tree-sitter-c` library.
 TSLanguage *tree_sitter_c();
 
+#if HAVE_TREE_SITTER_CPP
 // Declare the `tree_sitter_cpp` function, which is
 // implemented by the `tree-sitter-cpp` library.
-//TSLanguage *tree_sitter_cpp();
+TSLanguage *tree_sitter_cpp();
+#endif
 
-int main(int argc, char **argv) {
-	if (argc < 1) {
-		printf("Usage ts-c-cpp-parser <filename>\n");
-		return -1;
-	}
-	char *file_path = argv[1];
-	if (!file_path) {
-		printf("Usage ts-c-cpp-parser <filename>\n");
-		return -1;
+#if HAVE_TREE_SITTER_C_DECL
+// Declare the `tree_sitter_c_decl` function, which is implemented by
+// the declarations-only variant of the `tree-sitter-c` library.
+TSLanguage *tree_sitter_c_decl();
+#endif
+
+// Inputs parsed with the declarations-only C grammar, where
+// the function bodies and the initializers are opaque
+typedef enum {
+	DECL_GRAMMAR_OFF = 0,
+	DECL_GRAMMAR_SOURCES, // The ".c" and ".i" inputs, e.g. the amalgamations
+	DECL_GRAMMAR_ALL,
+} DeclGrammar;
+
+// Only the beginning of the input is sniffed, the C++ headers
+// declare a namespace or a class early
+#define SNIFF_BYTES 0x4000
+
+static bool starts_with_word(const char *line, const char *word) {
+	size_t len = strlen(word);
+	return !strncmp(line, word, len) && !(isalnum((ut8)line[len]) || line[len] == '_');
+}
+
+static bool sniff_cpp(const char *text, size_t len) {
+	len = RZ_MIN(len, SNIFF_BYTES);
+	const char *end = text + len;
+	const char *line = text;
+	while (line < end) {
+		while (line < end && (*line == ' ' || *line == '\t')) {
+			line++;
+		}
+		if (starts_with_word(line, "namespace") || starts_with_word(line, "class")
+			|| starts_with_word(line, "template") || starts_with_word(line, "using")
+			|| !strncmp(line, "public:", 7) || !strncmp(line, "private:", 8) || !strncmp(line, "protected:", 10)) {
+			return true;
+		}
+		const char *eol = memchr(line, '\n', end - line);
+		line = eol ? eol + 1 : end;
 	}
-	bool verbose = false;
-	if (argc > 2 && argv[2]) {
-		// poor-men argument parsing
-		if (!strcmp(argv[2], "-v") || !strcmp(argv[2], "--verbose")) {
-			verbose = true;
+	return false;
+}
+
+// Picks the grammar by the extension, the ambiguous ".h" and unknown
+// ones are sniffed. Headers mentioning __cplusplus are shared with C,
+// their C++ parts are guarded, so the smaller C grammar is used for them
+static CParserLang detect_language(const char *path, const char *text, size_t len) {
+	static const char *cpp_exts[] = { ".cpp", ".cc", ".cxx", ".c++", ".hpp", ".hh", ".hxx", ".h++", ".ipp", ".tpp", ".inl" };
+	const char *ext = rz_str_lchr(path, '.');
+	if (ext) {
+		if (!strcmp(ext, ".c")) {
+			return C_PARSER_LANG_C;
 		}
+		size_t i;
+		for (i = 0; i < RZ_ARRAY_SIZE(cpp_exts); i++) {
+			if (!rz_str_casecmp(ext, cpp_exts[i])) {
+				return C_PARSER_LANG_CPP;
+			}
+		}
+	}
+	if (rz_str_nstr((char *)text, (char *)"__cplusplus", RZ_MIN(len, SNIFF_BYTES))) {
+		return C_PARSER_LANG_C;
+	}
+	return sniff_cpp(text, len) ? C_PARSER_LANG_CPP : C_PARSER_LANG_C;
+}
+
+static bool is_c_source(const char *path) {
+	const char *ext = rz_str_lchr(path, '.');
+	return ext && (!strcmp(ext, ".c") || !strcmp(ext, ".i"));
+}
+
+static const TSLanguage *parser_language(CParserLang lang, bool decl) {
+#if HAVE_TREE_SITTER_CPP
+	if (lang == C_PARSER_LANG_CPP) {
+		return tree_sitter_cpp();
+	}
+#endif
+#if HAVE_TREE_SITTER_C_DECL
+	if (decl) {
+		return tree_sitter_c_decl();
 	}
+#endif
+	return tree_sitter_c();
+}
 
+static int parse_file(CParserState *state, TSParser *parser, const char *file_path, const CParserLang *forced, DeclGrammar decl_grammar) {
+	bool verbose = state->verbose;
 	size_t read_bytes = 0;
-	const char *source_code = rz_file_slurp(file_path, &read_bytes);
+	c_parser_stats_start(state, C_PARSER_PHASE_READ);
+	char *source_code = rz_file_slurp(file_path, &read_bytes);
+	c_parser_stats_stop(state, C_PARSER_PHASE_READ);
 	if (!source_code || !read_bytes) {
+		free(source_code);
 		return -1;
 	}
+	state->stats.files++;
+	state->stats.bytes += read_bytes;
 	ut64 file_size = rz_file_size(file_path);
 	printf("File size is %"PFMT64d" bytes, read %zu bytes\n", file_size, read_bytes);
 
-	// Create a parser.
-	TSParser *parser = ts_parser_new();
-	// Set the parser's language (C in this case)
-	ts_parser_set_language(parser, tree_sitter_c());
+	CParserLang lang = forced ? *forced : detect_language(file_path, source_code, read_bytes);
+#if !HAVE_TREE_SITTER_CPP
+	if (lang == C_PARSER_LANG_CPP) {
+		eprintf("Built without the C++ grammar, parsing \"%s\" as C\n", file_path);
+		lang = C_PARSER_LANG_C;
+	}
+#endif
+	bool decl = lang == C_PARSER_LANG_C
+		&& (decl_grammar == DECL_GRAMMAR_ALL || (decl_grammar == DECL_GRAMMAR_SOURCES && is_c_source(file_path)));
+	const TSLanguage *language = parser_language(lang, decl);
+	if (language != state->language) {
+		state->lang = lang;
+		state->language = language;
+		ts_parser_set_language(parser, state->language);
+	}
+	if (verbose) {
+		printf("Language: %s\n", lang == C_PARSER_LANG_CPP ? "C++" : decl ? "C (declarations only)" : "C");
+	}
 
+	c_parser_set_budget(state, state->budget);
+	c_parser_stats_start(state, C_PARSER_PHASE_PARSE);
 	TSTree *tree = ts_parser_parse_string(
 		parser,
 		NULL,
 		source_code,
 		strlen(source_code));
+	c_parser_stats_stop(state, C_PARSER_PHASE_PARSE);
+	if (!tree) {
+		// Timed out or cancelled, the parser should be reset,
+		// otherwise it resumes this parse on the next call
+		eprintf("Parsing \"%s\" was stopped, the time budget expired or cancelled\n", file_path);
+		if (!state->cancel) {
+			state->stats.budgets_expired++;
+		}
+		ts_parser_reset(parser);
+		free(source_code);
+		return -1;
+	}
 
 	// Get the root node of the syntax tree.
 	TSNode root_node = ts_tree_root_node(tree);
@@ -57,7 +168,7 @@ int main(int argc, char **argv) {
 	if (!root_node_child_count) {
 		printf("Root node is empty!\n");
 		ts_tree_delete(tree);
-		ts_parser_delete(parser);
+		free(source_code);
 		return 0;
 	}
 
@@ -70,16 +181,6 @@ int main(int argc, char **argv) {
 		free(string);
 	}
 
-	// Create new C parser state
-	CParserState *state = c_parser_state_new();
-	if (!state) {
-		eprintf("CParserState initialization error!\n");
-		ts_tree_delete(tree);
-		ts_parser_delete(parser);
-		return -1;
-	}
-	state->verbose = verbose;
-
 	// At first step we should handle defines
 	// #define
 	// #if / #ifdef
@@ -89,17 +190,610 @@ int main(int argc, char **argv) {
 	// And only after that - run the normal C/C++ syntax parsing
 
 	// Filter types function prototypes and start parsing
+	c_parser_stats_start(state, C_PARSER_PHASE_WALK);
 	int i = 0;
 	for (i = 0; i < root_node_child_count; i++) {
 		if (verbose) {
 			printf("Processing %d child...\n", i);
 		}
+		if (c_parser_should_stop(state)) {
+			// Keep the types extracted so far
+			eprintf("Processing \"%s\" was stopped, the results are partial\n", file_path);
+			break;
+		}
 		TSNode child = ts_node_named_child(root_node, i);
 		filter_type_nodes(state, child, source_code);
 	}
+	c_parser_stats_stop(state, C_PARSER_PHASE_WALK);
+
+	// Diagnostics keep only the byte ranges, render them while
+	// the source is still around
+	c_parser_diags_print(state, source_code, read_bytes);
+	c_parser_diags_clear(state);
+	c_parser_line_index_reset(state);
 
-	c_parser_state_free(state);
 	ts_tree_delete(tree);
+	free(source_code);
+	return 0;
+}
+
+typedef struct {
+	CTypeStore *store;
+	char **files;
+	int files_count;
+	atomic_int next; // Next input to take
+	const CParserLang *forced;
+	DeclGrammar decl_grammar;
+} ParallelJob;
+
+typedef struct {
+	ParallelJob *job;
+	ut32 id;
+	CParserState *state; // Keeps the signatures and the globals of the worker, the interner is shared
+	RzThread *thread;
+	int result;
+} ParallelWorker;
+
+// The repeated types of the common headers are dropped by the workers,
+// rather than batched and published to be merged under the shard lock
+static bool parallel_type_published(CTypeStore *store, int reader, CType *type) {
+	char *key = c_type_key(type->kind, type->name);
+	if (!key) {
+		return false;
+	}
+	c_type_store_enter(store, reader);
+	CType *stored = c_type_store_find(store, key);
+	bool published = stored && stored->forward == type->forward && c_type_equal(stored, type);
+	c_type_store_leave(store, reader);
+	free(key);
+	return published;
+}
+
+static void *parallel_worker(void *user) {
+	ParallelWorker *worker = user;
+	ParallelJob *job = worker->job;
+	CParserState *state = worker->state;
+	TSParser *parser = ts_parser_new();
+	CTypeStoreBatch *batch = c_type_store_batch_new(job->store);
+	// Without a reader slot every type goes through the batch
+	int reader = c_type_store_reader(job->store);
+	RzPVector types;
+	rz_pvector_init(&types, NULL);
+	if (!parser || !batch) {
+		worker->result = -1;
+		goto beach;
+	}
+	ts_parser_set_timeout_micros(parser, state->budget);
+	ts_parser_set_cancellation_flag(parser, &state->cancel);
+	int i;
+	while (!state->cancel && (i = atomic_fetch_add(&job->next, 1)) < job->files_count) {
+		if (parse_file(state, parser, job->files[i], job->forced, job->decl_grammar)) {
+			eprintf("Cannot parse \"%s\"\n", job->files[i]);
+			worker->result = -1;
+		}
+		// The worker keeps none of the types, so the
+		// repeated ones get merged by the store
+		if (!c_parser_take_types(state, &types)) {
+			worker->result = -1;
+			continue;
+		}
+		void **it;
+		rz_pvector_foreach (&types, it) {
+			CType *type = *it;
+			if (reader >= 0 && parallel_type_published(job->store, reader, type)) {
+				state->types_merged++;
+				c_type_free(type);
+				continue;
+			}
+			type->origin = worker->id;
+			c_type_store_batch_add(batch, type);
+		}
+		rz_pvector_clear(&types);
+	}
+	c_type_store_batch_flush(batch);
+beach:
+	rz_pvector_fini(&types);
+	c_type_store_batch_free(batch);
 	ts_parser_delete(parser);
+#if HAVE_TS_ARENA
+	// The pool counters are per thread
+	c_ts_alloc_stats(&state->stats.ts_alloc);
+#endif
+	return NULL;
+}
+
+// Parses the inputs with the worker threads, each with its own parser and
+// state, taking the next input once done with the previous one. The types
+// are published into the shared store, and the signatures and the globals
+// are merged once the workers finish. Which one of the conflicting
+// definitions wins depends on the timing
+static int parse_parallel(CParserState *state, char **files, int files_count, const CParserLang *forced, DeclGrammar decl_grammar, int jobs) {
+	ParallelJob job = {
+		.store = c_type_store_new(),
+		.files = files,
+		.files_count = files_count,
+		.forced = forced,
+		.decl_grammar = decl_grammar,
+	};
+	atomic_init(&job.next, 0);
+	ParallelWorker *workers = RZ_NEWS0(ParallelWorker, jobs);
+	ut32 **functions = RZ_NEWS0(ut32 *, jobs);
+	if (!job.store || !workers || !functions) {
+		c_type_store_free(job.store);
+		free(workers);
+		free(functions);
+		return -1;
+	}
+	int result = 0;
+	int started = 0;
+	int i;
+	for (i = 0; i < jobs; i++) {
+		ParallelWorker *worker = &workers[started];
+		worker->job = &job;
+		worker->id = started;
+		worker->state = c_parser_state_new_shared(state);
+		if (!worker->state) {
+			break;
+		}
+		worker->state->verbose = state->verbose;
+		worker->state->budget = state->budget;
+		worker->state->pointer_size = state->pointer_size;
+		worker->thread = rz_th_new(parallel_worker, worker);
+		if (!worker->thread) {
+			c_parser_state_free(worker->state);
+			break;
+		}
+		started++;
+	}
+	if (!started) {
+		eprintf("Cannot start the parallel workers\n");
+		result = -1;
+	}
+	for (i = 0; i < started; i++) {
+		rz_th_wait(workers[i].thread);
+		rz_th_free(workers[i].thread);
+	}
+
+	// Worker order, thus the same inputs give the same ids
+	// unless the workers took them differently
+	for (i = 0; i < started; i++) {
+		CParserState *worker_state = workers[i].state;
+		result |= workers[i].result;
+		functions[i] = c_parser_merge_functions(state, worker_state);
+		if (!c_parser_merge_globals(state, worker_state, functions[i])) {
+			result = -1;
+		}
+		c_parser_stats_merge(state, worker_state);
+		state->types_merged += worker_state->types_merged;
+		state->types_conflicts += worker_state->types_conflicts;
+		state->functions_merged += worker_state->functions_merged;
+		state->functions_conflicts += worker_state->functions_conflicts;
+		state->globals_conflicts += worker_state->globals_conflicts;
+		c_parser_state_free(worker_state);
+	}
+	CTypeStoreStats stats;
+	c_type_store_stats(job.store, &stats);
+	state->types_merged += stats.merged;
+	state->types_conflicts += stats.conflicts;
+	if (state->verbose) {
+		printf("Type store: %" PFMT64u " types %" PFMT64u " batches %" PFMT64u " resizes %" PFMT64u " reclaimed\n",
+			stats.types, stats.batches, stats.resizes, stats.reclaimed);
+	}
+
+	// All the keys are distinct by now, storing only links the records
+	RzPVector types;
+	rz_pvector_init(&types, NULL);
+	if (!c_type_store_take(job.store, &types)) {
+		result = -1;
+	}
+	void **it;
+	rz_pvector_foreach (&types, it) {
+		CType *type = *it;
+		const ut32 *ids = type->origin < (ut32)started ? functions[type->origin] : NULL;
+		CTypeMember *member;
+		rz_vector_foreach(&type->members, member) {
+			member->function = ids && member->function ? ids[member->function] : 0;
+		}
+		c_parser_store_type(state, type);
+	}
+	rz_pvector_fini(&types);
+	for (i = 0; i < started; i++) {
+		free(functions[i]);
+	}
+	free(functions);
+	free(workers);
+	c_type_store_free(job.store);
+	return result;
+}
+
+// Only the prototypes, the function pointer types are shown with the members
+static void print_signatures(CParserState *state) {
+	CFunction *fn;
+	rz_vector_foreach(&state->functions, fn) {
+		if (!fn->name) {
+			continue;
+		}
+		char *signature = c_parser_function_string(state, fn);
+		if (signature) {
+			printf("%s\n", signature);
+		}
+		free(signature);
+	}
+}
+
+static void print_globals(CParserState *state) {
+	CGlobal *global;
+	rz_vector_foreach(&state->globals, global) {
+		printf("%s: %s%s%s\n", c_parser_atom(state, global->name), c_parser_atom(state, global->type),
+			global->storage & C_STORAGE_STATIC ? " static" : "",
+			global->defined ? "" : " extern");
+	}
+}
+
+// Query is "struct S1:8", the offset is the last component
+static void print_member_at(CParserState *state, const char *query) {
+	const char *colon = strrchr(query, ':');
+	if (!colon) {
+		eprintf("Invalid --member-at query \"%s\", expected <type>:<offset>\n", query);
+		return;
+	}
+	char *name = rz_str_ndup(query, colon - query);
+	CType *type = name ? c_parser_find_type(state, name) : NULL;
+	if (!type) {
+		eprintf("Unknown type \"%s\"\n", name ? name : query);
+		free(name);
+		return;
+	}
+	ut32 offset = strtoul(colon + 1, NULL, 0);
+	char *path = c_parser_member_at(state, type, offset);
+	printf("%s+%u: %s\n", name, offset, path ? path : "(padding)");
+	free(path);
+	free(name);
+}
+
+// Query is "enum E:0x41", the value is decomposed into flags if needed
+static void print_enum_value(CParserState *state, const char *query) {
+	const char *colon = strrchr(query, ':');
+	if (!colon) {
+		eprintf("Invalid --enum-value query \"%s\", expected <enum>:<value>\n", query);
+		return;
+	}
+	char *name = rz_str_ndup(query, colon - query);
+	CType *type = name ? c_parser_find_type(state, name) : NULL;
+	char *flags = type ? c_parser_enum_flags(state, type, strtoull(colon + 1, NULL, 0)) : NULL;
+	if (!flags) {
+		eprintf("Unknown enum \"%s\"\n", name ? name : query);
+	} else {
+		printf("%s: %s\n", query, flags);
+	}
+	free(flags);
+	free(name);
+}
+
+static int load_type_lib(const char *path, const char *complete) {
+	ut64 start = rz_time_now_mono();
+	CTypeLib *lib = c_type_lib_open(path);
+	if (!lib) {
+		return -1;
+	}
+	ut64 elapsed = rz_time_now_mono() - start;
+	printf("Type library \"%s\": %u types, %u members, opened in %" PFMT64u " us\n",
+		path, lib->header->types_count, lib->header->members_count, elapsed);
+	if (complete) {
+		RzPVector *matches = c_type_lib_complete(lib, complete);
+		void **it;
+		if (matches) {
+			rz_pvector_foreach (matches, it) {
+				const CTypeLibType *type = *it;
+				printf("%s\n", c_type_lib_string(lib, type->key));
+			}
+			rz_pvector_free(matches);
+		}
+	}
+	c_type_lib_close(lib);
 	return 0;
 }
+
+// Parses the edited headers again into the state, the newer definitions
+// replace the stored ones, and lays out only the types affected by them
+static int reimport_headers(CParserState *state, TSParser *parser, char **headers, int headers_count, DeclGrammar decl_grammar) {
+	int result = 0;
+	int i;
+	state->redefine = true;
+	for (i = 0; i < headers_count; i++) {
+		ut64 redefined = state->types_redefined;
+		ut64 start = rz_time_now_mono();
+		if (parse_file(state, parser, headers[i], NULL, decl_grammar)) {
+			eprintf("Cannot parse \"%s\"\n", headers[i]);
+			result = -1;
+		}
+		ut64 parsed = rz_time_now_mono();
+		ut32 invalid = rz_pvector_len(&state->invalid);
+		int incomplete = c_parser_update_layouts(state);
+		ut64 end = rz_time_now_mono();
+		printf("Reimport \"%s\": %" PFMT64u " redefined, %u laid out again, parsed in %" PFMT64u " us, laid out in %" PFMT64u " us\n",
+			headers[i], state->types_redefined - redefined, invalid, parsed - start, end - parsed);
+		if (incomplete > 0) {
+			printf("Types without layout: %d\n", incomplete);
+		}
+	}
+	state->redefine = false;
+	return result;
+}
+
+typedef struct {
+	ut32 added;
+	ut32 replaced;
+	bool verbose;
+} TryDiff;
+
+static void try_diff_cb(void *user, const char *key, const CType *old_type, const CType *new_type) {
+	TryDiff *diff = user;
+	diff->added += !old_type;
+	diff->replaced += old_type && new_type;
+	if (diff->verbose) {
+		printf("  %c %s\n", !old_type ? '+' : new_type ? '~' : '-', key);
+	}
+}
+
+// Imports every header into its own version of the parsed types, reports
+// the changes and rolls the import back. The parsed types are moved into
+// the base version once, the versions of the headers share them
+static int try_headers(CParserState *state, TSParser *parser, char **tries, int tries_count, DeclGrammar decl_grammar) {
+	CTypeDb *base = c_type_db_new();
+	RzPVector types;
+	rz_pvector_init(&types, NULL);
+	if (!base || !c_parser_take_types(state, &types)) {
+		c_type_db_free(base);
+		rz_pvector_fini(&types);
+		return -1;
+	}
+	int result = 0;
+	void **it;
+	rz_pvector_foreach (&types, it) {
+		if (!c_type_db_set(base, *it)) {
+			result = -1;
+		}
+	}
+	rz_pvector_clear(&types);
+	int i;
+	for (i = 0; i < tries_count; i++) {
+		ut64 start = rz_time_now_mono();
+		CTypeDb *version = c_type_db_snapshot(base);
+		ut64 snapshot_time = rz_time_now_mono() - start;
+		CParserState *try_state = version ? c_parser_state_new_shared(state) : NULL;
+		if (!try_state) {
+			c_type_db_free(version);
+			result = -1;
+			break;
+		}
+		try_state->verbose = state->verbose;
+		try_state->budget = state->budget;
+		ts_parser_set_cancellation_flag(parser, &try_state->cancel);
+		if (parse_file(try_state, parser, tries[i], NULL, decl_grammar)) {
+			eprintf("Cannot parse \"%s\"\n", tries[i]);
+			result = -1;
+		}
+		ts_parser_set_cancellation_flag(parser, &state->cancel);
+		start = rz_time_now_mono();
+		if (!c_parser_take_types(try_state, &types)) {
+			result = -1;
+		}
+		rz_pvector_foreach (&types, it) {
+			if (!c_type_db_set(version, *it)) {
+				result = -1;
+			}
+		}
+		rz_pvector_clear(&types);
+		ut64 import_time = rz_time_now_mono() - start;
+		TryDiff diff = { .verbose = state->verbose };
+		c_type_db_diff(base, version, try_diff_cb, &diff);
+		CTypeDbStats stats;
+		c_type_db_stats(version, &stats);
+		printf("Try \"%s\": %u added, %u replaced, %u types, snapshot in %" PFMT64u " us, import in %" PFMT64u " us, %u of %u nodes shared\n",
+			tries[i], diff.added, diff.replaced, stats.types, snapshot_time, import_time, stats.shared, stats.nodes);
+		// Rolling back only drops the version
+		c_type_db_free(version);
+		c_parser_state_free(try_state);
+	}
+	rz_pvector_fini(&types);
+	c_type_db_free(base);
+	return result;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Usage ts-c-cpp-parser [-v] [--stats] [--signatures] [--globals] [-j <jobs>] [--lang c|c-decl|c++] [--decl-grammar] [--compare-rz-type] [--timeout <ms>] [--complete <prefix>] [--member-at <type>:<offset>] [--enum-value <enum>:<value>] [--save-db <path>] [--load-db <path>] [--try <header>] [--reimport <header>] <filename> [<filename> ...]\n");
+		return -1;
+	}
+	bool verbose = false;
+	bool stats = false;
+	bool compare = false;
+	bool signatures = false;
+	bool globals = false;
+	bool lang_forced = false;
+	CParserLang lang = C_PARSER_LANG_C;
+	DeclGrammar decl_grammar = DECL_GRAMMAR_OFF;
+	int jobs = 1;
+	ut64 budget = 0;
+	const char *complete = NULL;
+	const char *member_at = NULL;
+	const char *enum_value = NULL;
+	const char *save_db = NULL;
+	const char *load_db = NULL;
+	char **files = RZ_NEWS0(char *, argc);
+	int files_count = 0;
+	char **tries = RZ_NEWS0(char *, argc);
+	int tries_count = 0;
+	char **reimports = RZ_NEWS0(char *, argc);
+	int reimports_count = 0;
+	if (!files || !tries || !reimports) {
+		free(files);
+		free(tries);
+		free(reimports);
+		return -1;
+	}
+	int i;
+	for (i = 1; i < argc; i++) {
+		// poor-men argument parsing
+		if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose")) {
+			verbose = true;
+		} else if (!strcmp(argv[i], "--stats")) {
+			stats = true;
+		} else if (!strcmp(argv[i], "--lang") && i + 1 < argc) {
+			i++;
+			lang_forced = true;
+			lang = !strcmp(argv[i], "c++") || !strcmp(argv[i], "cpp") ? C_PARSER_LANG_CPP : C_PARSER_LANG_C;
+			if (!strcmp(argv[i], "c-decl")) {
+				decl_grammar = DECL_GRAMMAR_ALL;
+			}
+		} else if (!strcmp(argv[i], "--decl-grammar")) {
+			if (decl_grammar == DECL_GRAMMAR_OFF) {
+				decl_grammar = DECL_GRAMMAR_SOURCES;
+			}
+		} else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+			// 0 picks the number of the cores
+			jobs = atoi(argv[++i]);
+			if (jobs <= 0) {
+				jobs = RZ_MAX(rz_th_physical_core_number(), 1);
+			}
+		} else if (!strcmp(argv[i], "--globals")) {
+			globals = true;
+		} else if (!strcmp(argv[i], "--signatures")) {
+			signatures = true;
+		} else if (!strcmp(argv[i], "--compare-rz-type")) {
+			compare = true;
+		} else if (!strcmp(argv[i], "--complete") && i + 1 < argc) {
+			complete = argv[++i];
+		} else if (!strcmp(argv[i], "--member-at") && i + 1 < argc) {
+			member_at = argv[++i];
+		} else if (!strcmp(argv[i], "--enum-value") && i + 1 < argc) {
+			enum_value = argv[++i];
+		} else if (!strcmp(argv[i], "--save-db") && i + 1 < argc) {
+			save_db = argv[++i];
+		} else if (!strcmp(argv[i], "--load-db") && i + 1 < argc) {
+			load_db = argv[++i];
+		} else if (!strcmp(argv[i], "--try") && i + 1 < argc) {
+			// What-if import on top of the parsed types, rolled back afterwards
+			tries[tries_count++] = argv[++i];
+		} else if (!strcmp(argv[i], "--reimport") && i + 1 < argc) {
+			// Edited header, imported again once the layouts are computed
+			reimports[reimports_count++] = argv[++i];
+		} else if (!strcmp(argv[i], "--timeout") && i + 1 < argc) {
+			budget = strtoull(argv[++i], NULL, 10) * 1000;
+		} else if (*argv[i] != '-') {
+			files[files_count++] = argv[i];
+		}
+	}
+
+#if !HAVE_TREE_SITTER_C_DECL
+	if (decl_grammar != DECL_GRAMMAR_OFF) {
+		eprintf("Built without the declarations-only grammar, using the full C grammar\n");
+		decl_grammar = DECL_GRAMMAR_OFF;
+	}
+#endif
+
+	// Create a parser.
+	TSParser *parser = ts_parser_new();
+	// Language is set for every input, see detect_language()
+	// Time budget is per file, so one broken header cannot stall the rest
+	ts_parser_set_timeout_micros(parser, budget);
+
+	// Create new C parser state, shared by all files, so the types
+	// repeated across the headers are merged together
+	CParserState *state = c_parser_state_new();
+	if (!state) {
+		eprintf("CParserState initialization error!\n");
+		ts_parser_delete(parser);
+		free(files);
+		free(tries);
+		free(reimports);
+		return -1;
+	}
+	state->verbose = verbose;
+	state->budget = budget;
+	ts_parser_set_cancellation_flag(parser, &state->cancel);
+	if (stats) {
+		c_parser_stats_counters_start(state);
+	}
+
+	int result = 0;
+	if (jobs > 1 && files_count > 1) {
+		result = parse_parallel(state, files, files_count, lang_forced ? &lang : NULL, decl_grammar, RZ_MIN(jobs, files_count));
+	} else {
+		for (i = 0; i < files_count && !state->cancel; i++) {
+			if (parse_file(state, parser, files[i], lang_forced ? &lang : NULL, decl_grammar)) {
+				eprintf("Cannot parse \"%s\"\n", files[i]);
+				result = -1;
+			}
+		}
+	}
+	if (verbose || stats) {
+		printf("Types merged: %"PFMT64u" conflicts: %"PFMT64u"\n", state->types_merged, state->types_conflicts);
+		printf("Signatures: %u prototypes merged: %"PFMT64u" conflicts: %"PFMT64u"\n", (ut32)rz_vector_len(&state->functions) - 1,
+			state->functions_merged, state->functions_conflicts);
+		printf("Globals: %u conflicts: %"PFMT64u"\n", (ut32)rz_vector_len(&state->globals), state->globals_conflicts);
+	}
+
+	// Layouts are computed once all the headers are processed,
+	// since the types can be defined in any order
+	c_parser_stats_start(state, C_PARSER_PHASE_EMIT);
+	int incomplete = c_parser_compute_layouts(state);
+	if (incomplete > 0) {
+		printf("Types without layout: %d\n", incomplete);
+	}
+	c_parser_index_enums(state);
+	c_parser_stats_stop(state, C_PARSER_PHASE_EMIT);
+	if (reimports_count && reimport_headers(state, parser, reimports, reimports_count, decl_grammar)) {
+		result = -1;
+	}
+	if (complete) {
+		RzPVector *matches = c_parser_complete_type(state, complete);
+		void **it;
+		if (matches) {
+			rz_pvector_foreach (matches, it) {
+				CType *type = *it;
+				char *key = c_type_key(type->kind, type->name);
+				printf("%s\n", key);
+				free(key);
+			}
+			rz_pvector_free(matches);
+		}
+	}
+	if (signatures) {
+		print_signatures(state);
+	}
+	if (globals) {
+		print_globals(state);
+	}
+	if (member_at) {
+		print_member_at(state, member_at);
+	}
+	if (enum_value) {
+		print_enum_value(state, enum_value);
+	}
+	if (save_db && c_type_lib_save(state, save_db)) {
+		result = -1;
+	}
+	if (load_db && load_type_lib(load_db, complete)) {
+		result = -1;
+	}
+	if (compare && c_parser_compare_rz_type(state, files_count, files)) {
+		result = -1;
+	}
+	// Takes the types of the state, so it goes last
+	if (tries_count && try_headers(state, parser, tries, tries_count, decl_grammar)) {
+		result = -1;
+	}
+	if (stats) {
+		c_parser_stats_counters_stop(state);
+		c_parser_stats_print(state);
+	}
+
+	c_parser_state_free(state);
+	ts_parser_delete(parser);
+	free(files);
+	free(tries);
+	free(reimports);
+	return result;
+}
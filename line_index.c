@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_util/rz_assert.h>
+
+#include <line_index.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LINE_INDEX_VECTOR 32
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LINE_INDEX_VECTOR 16
+#endif
+
+static inline ut32 ctz32(ut32 x) {
+#if defined(_MSC_VER)
+	unsigned long r;
+	_BitScanForward(&r, x);
+	return r;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+static bool push_start(CLineIndex *index, ut32 offset) {
+	if (index->count == index->capacity) {
+		ut32 capacity = index->capacity ? index->capacity * 2 : 256;
+		ut32 *starts = realloc(index->starts, capacity * sizeof(ut32));
+		if (!starts) {
+			return false;
+		}
+		index->starts = starts;
+		index->capacity = capacity;
+	}
+	index->starts[index->count++] = offset;
+	return true;
+}
+
+// Builds the index with a single vectorized scan for '\n', comparing
+// 16 or 32 bytes at once and walking the set bits of the match mask
+bool c_line_index_build(CLineIndex *index, const char *text, size_t len) {
+	rz_return_val_if_fail(index && text, false);
+	index->count = 0;
+	index->text = text;
+	index->len = len;
+	// Offsets are ut32, the same as tree-sitter byte offsets
+	if (len > UT32_MAX || !push_start(index, 0)) {
+		return false;
+	}
+	size_t i = 0;
+#if LINE_INDEX_VECTOR == 32
+	const __m256i nl = _mm256_set1_epi8('\n');
+	for (; i + 32 <= len; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+		ut32 mask = (ut32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+		while (mask) {
+			if (!push_start(index, i + ctz32(mask) + 1)) {
+				return false;
+			}
+			mask &= mask - 1;
+		}
+	}
+#elif LINE_INDEX_VECTOR == 16
+	const __m128i nl = _mm_set1_epi8('\n');
+	for (; i + 16 <= len; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+		ut32 mask = (ut32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+		while (mask) {
+			if (!push_start(index, i + ctz32(mask) + 1)) {
+				return false;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+	while (i < len) {
+		const char *nl_ptr = memchr(text + i, '\n', len - i);
+		if (!nl_ptr) {
+			break;
+		}
+		i = nl_ptr - text + 1;
+		if (!push_start(index, i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void c_line_index_fini(CLineIndex *index) {
+	rz_return_if_fail(index);
+	free(index->starts);
+	memset(index, 0, sizeof(*index));
+}
+
+// Line and column are 1-based, column is counted in bytes
+void c_line_index_lookup(const CLineIndex *index, ut32 offset, ut32 *line, ut32 *column) {
+	rz_return_if_fail(index && index->count && line && column);
+	// Last line start that is not after the offset
+	ut32 lo = 0, hi = index->count;
+	while (hi - lo > 1) {
+		ut32 mid = lo + (hi - lo) / 2;
+		if (index->starts[mid] <= offset) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	*line = lo + 1;
+	*column = offset - index->starts[lo] + 1;
+}
@@ -0,0 +1,19 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <rz_types.h>
+
+// Sorted byte offsets of the line starts of an input buffer
+typedef struct {
+	ut32 *starts; // starts[0] is always 0
+	ut32 count;
+	ut32 capacity;
+	const char *text; // Input the index was built for, identity only
+	size_t len;
+} CLineIndex;
+
+bool c_line_index_build(CLineIndex *index, const char *text, size_t len);
+void c_line_index_fini(CLineIndex *index);
+void c_line_index_lookup(const CLineIndex *index, ut32 offset, ut32 *line, ut32 *column);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_assert.h>
+#include <tree_sitter/api.h>
+
+#include <types_parser.h>
+
+static const char *diag_messages[] = {
+	"Wrongly formed",
+};
+
+void c_parser_diag_add(CParserState *state, CParserDiagCode code, TSNode node, const char *what) {
+	rz_return_if_fail(state && what);
+	if (rz_vector_len(&state->diags) >= C_PARSER_DIAGS_MAX) {
+		state->diags_dropped++;
+		return;
+	}
+	CParserDiag diag = {
+		.code = code,
+		.symbol = ts_node_symbol(node),
+		.start = ts_node_start_byte(node),
+		.end = ts_node_end_byte(node),
+		.what = what,
+	};
+	rz_vector_push(&state->diags, &diag);
+}
+
+// Returns the line index of the input, building it on the first call,
+// so inputs without diagnostics never pay for the line tracking
+const CLineIndex *c_parser_line_index(CParserState *state, const char *text, size_t len) {
+	rz_return_val_if_fail(state && text, NULL);
+	if (state->lines.count && state->lines.text == text && state->lines.len == len) {
+		return &state->lines;
+	}
+	if (!c_line_index_build(&state->lines, text, len)) {
+		c_line_index_fini(&state->lines);
+		return NULL;
+	}
+	return &state->lines;
+}
+
+// Should be called once the input is released
+void c_parser_line_index_reset(CParserState *state) {
+	rz_return_if_fail(state);
+	c_line_index_fini(&state->lines);
+}
+
+void c_parser_diags_print(CParserState *state, const char *text, size_t len) {
+	rz_return_if_fail(state && text);
+	if (rz_vector_empty(&state->diags)) {
+		return;
+	}
+	const CLineIndex *lines = c_parser_line_index(state, text, len);
+	CParserDiag *diag;
+	rz_vector_foreach(&state->diags, diag) {
+		ut32 start = RZ_MIN(diag->start, len);
+		ut32 end = RZ_MIN(diag->end, len);
+		ut32 line = 0, column = 0;
+		if (lines) {
+			c_line_index_lookup(lines, start, &line, &column);
+		}
+		const char *symbol = state->language ? ts_language_symbol_name(state->language, diag->symbol) : "node";
+		// Only the first line of the node, up to C_PARSER_DIAG_EXCERPT bytes
+		ut32 excerpt = end - start;
+		const char *nl = memchr(text + start, '\n', excerpt);
+		if (nl) {
+			excerpt = nl - (text + start);
+		}
+		bool truncated = excerpt < end - start || excerpt > C_PARSER_DIAG_EXCERPT;
+		excerpt = RZ_MIN(excerpt, C_PARSER_DIAG_EXCERPT);
+		eprintf("%u:%u: %s %s (%s): %.*s%s\n", line, column,
+			diag_messages[diag->code], diag->what, symbol,
+			(int)excerpt, text + start, truncated ? "..." : "");
+	}
+	if (state->diags_dropped) {
+		eprintf("%" PFMT64u " more diagnostics were dropped\n", state->diags_dropped);
+	}
+}
+
+void c_parser_diags_clear(CParserState *state) {
+	rz_return_if_fail(state);
+	rz_vector_clear(&state->diags);
+	state->diags_dropped = 0;
+}
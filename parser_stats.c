@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_util/rz_assert.h>
+#include <rz_util/rz_time.h>
+#include <tree_sitter/api.h>
+
+#include <types_parser.h>
+#if HAVE_TS_ARENA
+#include <ts_alloc.h>
+#endif
+
+#if __UNIX__
+#include <sys/resource.h>
+#endif
+#if __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *phase_names[C_PARSER_PHASE_COUNT] = {
+	"read",
+	"parse",
+	"walk",
+	"emit",
+};
+
+// Timers are started and stopped once per phase of every file,
+// so they don't perturb the measured code
+void c_parser_stats_start(CParserState *state, CParserPhase phase) {
+	rz_return_if_fail(state && phase < C_PARSER_PHASE_COUNT);
+	state->stats.phase_start[phase] = rz_time_now_mono();
+}
+
+void c_parser_stats_stop(CParserState *state, CParserPhase phase) {
+	rz_return_if_fail(state && phase < C_PARSER_PHASE_COUNT);
+	state->stats.phase_time[phase] += rz_time_now_mono() - state->stats.phase_start[phase];
+	state->stats.phase_rss[phase] = c_parser_stats_peak_rss();
+}
+
+// Counts the instructions retired by the process with perf_event_open(2)
+// where available. It fails quietly e.g. in containers or when
+// perf_event_paranoid doesn't allow it
+void c_parser_stats_counters_start(CParserState *state) {
+	rz_return_if_fail(state);
+	state->stats.perf_fd = -1;
+#if __linux__
+	struct perf_event_attr attr = { 0 };
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// The parallel workers are counted once they exit
+	attr.inherit = 1;
+	int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd < 0) {
+		return;
+	}
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	state->stats.perf_fd = fd;
+#endif
+}
+
+// Adds the counters of a parallel worker, the phase times become the
+// CPU time summed over the workers. Types are counted once they are
+// stored into the state
+void c_parser_stats_merge(CParserState *state, const CParserState *src) {
+	rz_return_if_fail(state && src);
+	CParserStats *stats = &state->stats;
+	const CParserStats *other = &src->stats;
+	int i;
+	for (i = 0; i < C_PARSER_PHASE_COUNT; i++) {
+		stats->phase_time[i] += other->phase_time[i];
+		stats->phase_rss[i] = RZ_MAX(stats->phase_rss[i], other->phase_rss[i]);
+	}
+	stats->files += other->files;
+	stats->bytes += other->bytes;
+	stats->nodes += other->nodes;
+	stats->malformed += other->malformed;
+	stats->budgets_expired += other->budgets_expired;
+#if HAVE_TS_ARENA
+	c_ts_alloc_stats_add(&stats->ts_alloc, &other->ts_alloc);
+#endif
+	if (state->intern_cache && src->intern_cache) {
+		state->intern_cache->hits += src->intern_cache->hits;
+		state->intern_cache->misses += src->intern_cache->misses;
+	}
+}
+
+void c_parser_stats_counters_stop(CParserState *state) {
+	rz_return_if_fail(state);
+#if __linux__
+	int fd = state->stats.perf_fd;
+	if (fd < 0) {
+		return;
+	}
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	ut64 count = 0;
+	if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+		state->stats.instructions = count;
+	}
+	close(fd);
+	state->stats.perf_fd = -1;
+#endif
+}
+
+// Returns the peak resident set size of the process in bytes, 0 if unknown
+ut64 c_parser_stats_peak_rss(void) {
+#if __UNIX__
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+#if __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (ut64)usage.ru_maxrss * 1024;
+#endif
+#else
+	return 0;
+#endif
+}
+
+void c_parser_stats_print(CParserState *state) {
+	rz_return_if_fail(state);
+	CParserStats *stats = &state->stats;
+	ut64 total = 0;
+	int i;
+	printf("Stats:\n");
+	for (i = 0; i < C_PARSER_PHASE_COUNT; i++) {
+		printf("  %-6s %10.3f ms %10" PFMT64u " KB peak rss\n", phase_names[i],
+			stats->phase_time[i] / 1000.0, stats->phase_rss[i] / 1024);
+		total += stats->phase_time[i];
+	}
+	printf("  %-6s %10.3f ms\n", "total", total / 1000.0);
+	if (total) {
+		// Microseconds, thus bytes per microsecond is MB/s
+		printf("  throughput:     %.3f MB/s\n", (double)stats->bytes / total);
+		printf("  types/s:        %.0f\n", stats->types * 1000000.0 / total);
+	}
+	printf("  peak rss:       %" PFMT64u " KB\n", c_parser_stats_peak_rss() / 1024);
+	if (stats->instructions) {
+		printf("  instructions:   %" PFMT64u "\n", stats->instructions);
+	}
+	CInternStats interned;
+	c_interner_stats(state->interner, &interned);
+	printf("  interned:       %u strings, %" PFMT64u " KB, %" PFMT64u " locked inserts\n",
+		interned.strings, interned.bytes / 1024, interned.inserts_locked);
+	if (state->intern_cache) {
+		printf("  intern cache:   %" PFMT64u " hits %" PFMT64u " misses\n", state->intern_cache->hits, state->intern_cache->misses);
+	}
+	printf("  files:          %" PFMT64u "\n", stats->files);
+	printf("  bytes:          %" PFMT64u "\n", stats->bytes);
+	printf("  nodes visited:  %" PFMT64u "\n", stats->nodes);
+	printf("  types:          %" PFMT64u "\n", stats->types);
+	printf("  fields:         %" PFMT64u "\n", stats->fields);
+	printf("  malformed:      %" PFMT64u "\n", stats->malformed);
+	printf("  budget expired: %" PFMT64u "\n", stats->budgets_expired);
+	printf("  stored blocks:  %" PFMT64u " (estimated)\n", stats->stored_blocks);
+	printf("  stored bytes:   %" PFMT64u " (estimated)\n", stats->stored_bytes);
+#if HAVE_TS_ARENA
+	// The pool of this thread and the ones of the parallel workers
+	CTsAllocStats ts;
+	c_ts_alloc_stats(&ts);
+	c_ts_alloc_stats_add(&ts, &stats->ts_alloc);
+	printf("  tree-sitter allocations: %" PFMT64u " (%" PFMT64u " reused, %" PFMT64u " large)\n", ts.allocs, ts.reused, ts.large);
+	printf("  tree-sitter frees:       %" PFMT64u " reallocs: %" PFMT64u "\n", ts.frees, ts.reallocs);
+	printf("  tree-sitter peak:        %" PFMT64u " KB live, %" PFMT64u " KB pool\n", ts.peak_bytes / 1024, ts.pool_bytes / 1024);
+#endif
+}
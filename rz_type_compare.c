@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_list.h>
+#include <rz_util/rz_str.h>
+#include <rz_util/rz_file.h>
+#include <rz_util/rz_time.h>
+#include <rz_util/rz_assert.h>
+#include <rz_type.h>
+#include <tree_sitter/api.h>
+
+#include <types_parser.h>
+
+#if HAVE_RZ_TYPE_PARSE_C_STRING
+
+#if __UNIX__
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// rz_type parser produces SDB records, where every type
+// is declared by a line like "S1=struct" or "jint=typedef"
+static void collect_rz_types(HtPP *names, const char *sdb) {
+	const char *line = sdb;
+	while (line && *line) {
+		const char *end = strchr(line, '\n');
+		size_t len = end ? end - line : strlen(line);
+		const char *eq = memchr(line, '=', len);
+		if (eq && !memchr(line, '.', eq - line)) {
+			char *name = rz_str_ndup(line, eq - line);
+			char *kind = rz_str_ndup(eq + 1, len - (eq + 1 - line));
+			CTypeKind type_kind = C_TYPE_KIND_TYPEDEF;
+			bool known = true;
+			if (!strcmp(kind, "struct")) {
+				type_kind = C_TYPE_KIND_STRUCT;
+			} else if (!strcmp(kind, "union")) {
+				type_kind = C_TYPE_KIND_UNION;
+			} else if (!strcmp(kind, "enum")) {
+				type_kind = C_TYPE_KIND_ENUM;
+			} else if (strcmp(kind, "typedef")) {
+				known = false;
+			}
+			if (known && name) {
+				char *key = c_type_key(type_kind, name);
+				if (key) {
+					ht_pp_insert(names, key, NULL);
+					free(key);
+				}
+			}
+			free(name);
+			free(kind);
+		}
+		line = end ? end + 1 : NULL;
+	}
+}
+
+typedef struct {
+	HtPP *other;
+	HtPP *types; // Types of the state, to resolve the typedefs
+	ut64 missing;
+	bool verbose;
+	const char *label;
+} CompareCtx;
+
+static bool count_missing(void *user, const void *k, const void *v) {
+	CompareCtx *ctx = user;
+	bool found = false;
+	ht_pp_find(ctx->other, k, &found);
+	if (!found) {
+		ctx->missing++;
+		if (ctx->verbose) {
+			printf("  only in %s: %s\n", ctx->label, (const char *)k);
+		}
+	}
+	return true;
+}
+
+static bool count_type(void *user, const void *k, const void *v) {
+	(*(ut64 *)user)++;
+	return true;
+}
+
+// rz_type records only the named definitions, and names the anonymous
+// aggregates after their typedefs, e.g. "typedef struct { ... } A;" is
+// "struct A" there. C++ class names are aliased by typedefs of the same
+// name, which have no counterpart in rz_type either
+static bool collect_ts_type(void *user, const void *k, const void *v) {
+	CompareCtx *ctx = user;
+	const CType *type = v;
+	if (type->forward || type->anonymous) {
+		return true;
+	}
+	if (type->kind != C_TYPE_KIND_TYPEDEF || rz_vector_len(&type->members) != 1) {
+		ht_pp_insert(ctx->other, k, NULL);
+		return true;
+	}
+	const CTypeMember *member = rz_vector_index_ptr((RzVector *)&type->members, 0);
+	const CType *target = member->type && !member->pointers && !member->array
+		? ht_pp_find(ctx->types, member->type, NULL)
+		: NULL;
+	if (!target || target->kind == C_TYPE_KIND_TYPEDEF) {
+		ht_pp_insert(ctx->other, k, NULL);
+	} else if (target->anonymous) {
+		char *key = c_type_key(target->kind, type->name);
+		if (key) {
+			ht_pp_insert(ctx->other, key, NULL);
+			free(key);
+		}
+	} else if (strcmp(target->name, type->name)) {
+		ht_pp_insert(ctx->other, k, NULL);
+	}
+	return true;
+}
+
+typedef struct {
+	ut64 bytes;
+	ut64 time;
+	ut64 start_rss; // Peak RSS before the pass, in bytes
+	ut64 peak_rss;
+	int result;
+} RzTypePass;
+
+static int rz_type_pass(CParserState *state, int files_count, char **files, HtPP *rz_names, RzTypePass *pass) {
+	RzType *rz_type = rz_type_new();
+	if (!rz_type) {
+		return -1;
+	}
+	pass->start_rss = c_parser_stats_peak_rss();
+	int result = 0;
+	int i;
+	for (i = 0; i < files_count; i++) {
+		size_t read_bytes = 0;
+		char *source_code = rz_file_slurp(files[i], &read_bytes);
+		if (!source_code) {
+			eprintf("rz_type: cannot read \"%s\"\n", files[i]);
+			result = -1;
+			continue;
+		}
+		pass->bytes += read_bytes;
+		char *error_msg = NULL;
+		ut64 start = rz_time_now_mono();
+		char *sdb = rz_type_parse_c_string(rz_type, source_code, &error_msg);
+		pass->time += rz_time_now_mono() - start;
+		if (error_msg && state->verbose) {
+			eprintf("rz_type: %s: %s\n", files[i], error_msg);
+		}
+		collect_rz_types(rz_names, sdb);
+		free(error_msg);
+		free(sdb);
+		free(source_code);
+	}
+	pass->peak_rss = c_parser_stats_peak_rss();
+	rz_type_free(rz_type);
+	return result;
+}
+
+#if __UNIX__
+static bool write_name(void *user, const void *k, const void *v) {
+	int fd = *(int *)user;
+	// The terminator separates the names
+	size_t len = strlen(k) + 1;
+	return write(fd, k, len) == (ssize_t)len;
+}
+
+// The rz_type pass runs in a forked process, so its memory is measured
+// apart from ours. The process starts as a copy of this one, thus the
+// growth of its peak RSS is what the pass takes. The pass results and
+// the type names are sent back through a pipe
+static int rz_type_pass_forked(CParserState *state, int files_count, char **files, HtPP *rz_names, RzTypePass *pass) {
+	int fds[2];
+	if (pipe(fds)) {
+		return rz_type_pass(state, files_count, files, rz_names, pass);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return rz_type_pass(state, files_count, files, rz_names, pass);
+	}
+	if (!pid) {
+		close(fds[0]);
+		pass->result = rz_type_pass(state, files_count, files, rz_names, pass);
+		bool ok = write(fds[1], pass, sizeof(*pass)) == sizeof(*pass);
+		if (ok) {
+			ht_pp_foreach(rz_names, write_name, &fds[1]);
+		}
+		close(fds[1]);
+		_exit(ok ? 0 : 1);
+	}
+	close(fds[1]);
+	char *data = NULL;
+	size_t size = 0, capacity = 0;
+	while (true) {
+		if (size == capacity) {
+			capacity = capacity ? capacity * 2 : 4096;
+			char *grown = realloc(data, capacity);
+			if (!grown) {
+				break;
+			}
+			data = grown;
+		}
+		ssize_t n = read(fds[0], data + size, capacity - size);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		size += n;
+	}
+	close(fds[0]);
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) || size < sizeof(*pass)) {
+		eprintf("rz_type: the forked pass failed\n");
+		free(data);
+		return -1;
+	}
+	memcpy(pass, data, sizeof(*pass));
+	const char *name = data + sizeof(*pass);
+	const char *end = data + size;
+	while (name < end) {
+		const char *terminator = memchr(name, 0, end - name);
+		if (!terminator) {
+			break;
+		}
+		ht_pp_insert(rz_names, name, NULL);
+		name = terminator + 1;
+	}
+	free(data);
+	return pass->result;
+}
+#endif
+
+// Feeds the same headers to the rz_type parser and reports its throughput,
+// memory and the set of extracted types next to ours. Should be called
+// after the files are processed by the tree-sitter pipeline
+int c_parser_compare_rz_type(CParserState *state, int files_count, char **files) {
+	rz_return_val_if_fail(state && files, -1);
+	HtPP *rz_names = ht_pp_new0();
+	HtPP *ts_names = ht_pp_new0();
+	if (!rz_names || !ts_names) {
+		ht_pp_free(rz_names);
+		ht_pp_free(ts_names);
+		return -1;
+	}
+	ut64 ts_rss = c_parser_stats_peak_rss();
+	RzTypePass pass = { 0 };
+#if __UNIX__
+	int result = rz_type_pass_forked(state, files_count, files, rz_names, &pass);
+#else
+	int result = rz_type_pass(state, files_count, files, rz_names, &pass);
+#endif
+	CompareCtx collect = { .other = ts_names, .types = state->types };
+	ht_pp_foreach(state->types, collect_ts_type, &collect);
+
+	CParserStats *stats = &state->stats;
+	ut64 ts_time = stats->phase_time[C_PARSER_PHASE_PARSE] + stats->phase_time[C_PARSER_PHASE_WALK];
+	ut64 ts_count = 0, rz_count = 0;
+	ht_pp_foreach(ts_names, count_type, &ts_count);
+	ht_pp_foreach(rz_names, count_type, &rz_count);
+	CompareCtx ours = { rz_names, NULL, 0, state->verbose, "tree-sitter" };
+	CompareCtx theirs = { ts_names, NULL, 0, state->verbose, "rz_type" };
+	ht_pp_foreach(ts_names, count_missing, &ours);
+	ht_pp_foreach(rz_names, count_missing, &theirs);
+
+	// Our figure is the peak of the whole process, theirs is the
+	// growth of the peak over the state the pass started from
+	ut64 rz_rss = pass.peak_rss > pass.start_rss ? pass.peak_rss - pass.start_rss : 0;
+	printf("Comparison with rz_type:\n");
+	printf("  %-12s %10s %12s %8s %10s\n", "parser", "time ms", "MB/s", "types", "rss KB");
+	printf("  %-12s %10.3f %12.3f %8" PFMT64u " %10" PFMT64u "\n", "tree-sitter",
+		ts_time / 1000.0, ts_time ? (double)stats->bytes / ts_time : 0.0, ts_count, ts_rss / 1024);
+	printf("  %-12s %10.3f %12.3f %8" PFMT64u " %10" PFMT64u "\n", "rz_type",
+		pass.time / 1000.0, pass.time ? (double)pass.bytes / pass.time : 0.0, rz_count, rz_rss / 1024);
+	printf("  only in tree-sitter: %" PFMT64u " only in rz_type: %" PFMT64u "\n", ours.missing, theirs.missing);
+
+	ht_pp_free(ts_names);
+	ht_pp_free(rz_names);
+	return result;
+}
+
+#else
+
+int c_parser_compare_rz_type(CParserState *state, int files_count, char **files) {
+	eprintf("rz_type C parser is not available in this build\n");
+	return -1;
+}
+
+#endif
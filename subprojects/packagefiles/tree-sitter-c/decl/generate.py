@@ -0,0 +1,54 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: LGPL-3.0-only
+
+""" Portable python script to generate the declarations-only C parser with the tree-sitter CLI """
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+# ABI of the vendored tree-sitter runtime
+RUNTIME_ABI = 13
+
+
+def cli_version(cli):
+    out = subprocess.run([cli, "--version"], stdout=subprocess.PIPE, universal_newlines=True).stdout
+    m = re.search(r"(\d+)\.(\d+)\.(\d+)", out)
+    return tuple(int(x) for x in m.groups()) if m else (0, 0, 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--tree-sitter", required=True, help="tree-sitter CLI")
+    parser.add_argument("--grammar", required=True, help="grammar.js")
+    parser.add_argument("--outdir", required=True)
+    args = parser.parse_args()
+
+    workdir = os.path.join(args.outdir, "generate")
+    os.makedirs(workdir, exist_ok=True)
+    cmd = [args.tree_sitter, "generate"]
+    # Older CLIs only emit the ABI of the runtime, the newer
+    # ones default to a newer ABI than the vendored runtime
+    if cli_version(args.tree_sitter) >= (0, 20, 7):
+        cmd += ["--abi", str(RUNTIME_ABI)]
+    cmd.append(os.path.abspath(args.grammar))
+    if subprocess.run(cmd, cwd=workdir).returncode != 0:
+        sys.exit(1)
+
+    # parser.c and parser.h of the same CLI must go together,
+    # so the generated header is used instead of the upstream one
+    src = os.path.join(workdir, "src")
+    with open(os.path.join(src, "parser.c"), "r") as f:
+        code = f.read()
+    code = re.sub(r'#include [<"]tree_sitter/parser\.h[>"]', '#include "parser.h"', code)
+    with open(os.path.join(args.outdir, "parser.c"), "w") as f:
+        f.write(code)
+    shutil.copyfile(os.path.join(src, "tree_sitter", "parser.h"), os.path.join(args.outdir, "parser.h"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,46 @@
+// Declarations-only variant of the C grammar. The function bodies and
+// the initializers are single opaque tokens matched by the external
+// scanner, thus the statements get unreachable and are dropped from the
+// parse tables, and the trees of the code heavy inputs keep only the
+// declarations.
+
+const C = require('../grammar.js');
+
+// Replaces the content of the named field, keeping the rest of the rule
+function replaceField(rule, name, content) {
+  if (rule.type === 'FIELD' && rule.name === name) {
+    return field(name, content);
+  }
+  if (rule.members) {
+    return Object.assign({}, rule, {
+      members: rule.members.map(member => replaceField(member, name, content)),
+    });
+  }
+  if (rule.content) {
+    return Object.assign({}, rule, {
+      content: replaceField(rule.content, name, content),
+    });
+  }
+  return rule;
+}
+
+module.exports = grammar(C, {
+  name: 'c_decl',
+
+  externals: $ => [
+    $.opaque_body,
+    $.opaque_initializer,
+  ],
+
+  rules: {
+    // Statements at the top level are only an error recovery
+    // of the full grammar
+    _top_level_item: ($, original) => choice(
+      ...original.members.filter(member => !/statement/.test(member.name || '')),
+    ),
+
+    function_definition: ($, original) => replaceField(original, 'body', $.opaque_body),
+
+    init_declarator: ($, original) => replaceField(original, 'value', $.opaque_initializer),
+  },
+});
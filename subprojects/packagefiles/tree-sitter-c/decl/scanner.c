@@ -0,0 +1,171 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "parser.h"
+
+// External scanner of the declarations-only C grammar, matches the
+// function bodies and the initializers as single tokens. Brackets are
+// balanced, the string and character literals and the comments are
+// skipped, so the brackets inside them don't count.
+
+enum TokenType {
+	OPAQUE_BODY,
+	OPAQUE_INITIALIZER,
+};
+
+void *tree_sitter_c_decl_external_scanner_create(void) {
+	return NULL;
+}
+
+void tree_sitter_c_decl_external_scanner_destroy(void *payload) {
+}
+
+unsigned tree_sitter_c_decl_external_scanner_serialize(void *payload, char *buffer) {
+	return 0;
+}
+
+void tree_sitter_c_decl_external_scanner_deserialize(void *payload, const char *buffer, unsigned length) {
+}
+
+static inline void advance(TSLexer *lexer) {
+	lexer->advance(lexer, false);
+}
+
+static inline bool at_eof(TSLexer *lexer) {
+	return !lexer->lookahead;
+}
+
+static inline bool is_space(int c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+// Skips the literal up to the closing quote, the opening one is current
+static bool skip_literal(TSLexer *lexer) {
+	int quote = lexer->lookahead;
+	advance(lexer);
+	while (!at_eof(lexer) && lexer->lookahead != quote) {
+		if (lexer->lookahead == '\\') {
+			advance(lexer);
+			if (at_eof(lexer)) {
+				return false;
+			}
+		} else if (lexer->lookahead == '\n') {
+			// Unterminated, C literals don't span lines
+			return true;
+		}
+		advance(lexer);
+	}
+	if (at_eof(lexer)) {
+		return false;
+	}
+	advance(lexer);
+	return true;
+}
+
+// Skips the comment if there is one, the slash is already consumed
+static bool skip_comment(TSLexer *lexer) {
+	if (lexer->lookahead == '/') {
+		while (!at_eof(lexer) && lexer->lookahead != '\n') {
+			advance(lexer);
+		}
+		return true;
+	}
+	if (lexer->lookahead == '*') {
+		advance(lexer);
+		bool star = false;
+		while (!at_eof(lexer)) {
+			if (star && lexer->lookahead == '/') {
+				advance(lexer);
+				return true;
+			}
+			star = lexer->lookahead == '*';
+			advance(lexer);
+		}
+		return false;
+	}
+	return true;
+}
+
+// Consumes the balanced input up to the delimiter at the depth 0. For the
+// bodies the delimiter is the closing brace, which is consumed, for the
+// initializers it's a comma, a semicolon or an unmatched closing bracket,
+// which are left for the grammar
+static bool scan_balanced(TSLexer *lexer, bool body) {
+	unsigned depth = 0;
+	bool empty = true;
+	while (!at_eof(lexer)) {
+		int c = lexer->lookahead;
+		switch (c) {
+		case '{':
+		case '(':
+		case '[':
+			depth++;
+			advance(lexer);
+			break;
+		case '}':
+		case ')':
+		case ']':
+			if (!depth) {
+				return !body && !empty;
+			}
+			depth--;
+			advance(lexer);
+			if (body && !depth) {
+				lexer->mark_end(lexer);
+				return true;
+			}
+			break;
+		case ',':
+		case ';':
+			if (!depth && !body) {
+				return !empty;
+			}
+			advance(lexer);
+			break;
+		case '"':
+		case '\'':
+			if (!skip_literal(lexer)) {
+				return false;
+			}
+			break;
+		case '/':
+			advance(lexer);
+			if (!skip_comment(lexer)) {
+				return false;
+			}
+			break;
+		default:
+			advance(lexer);
+			break;
+		}
+		// The trailing whitespace isn't part of the token
+		if (!is_space(c)) {
+			empty = false;
+			lexer->mark_end(lexer);
+		}
+	}
+	return false;
+}
+
+bool tree_sitter_c_decl_external_scanner_scan(void *payload, TSLexer *lexer, const bool *valid_symbols) {
+	// Both are never expected at once, unless the parser recovers
+	// from an error, then the regular tokens are better
+	if (valid_symbols[OPAQUE_BODY] == valid_symbols[OPAQUE_INITIALIZER]) {
+		return false;
+	}
+	while (is_space(lexer->lookahead)) {
+		lexer->advance(lexer, true);
+	}
+	if (valid_symbols[OPAQUE_BODY]) {
+		if (lexer->lookahead != '{' || !scan_balanced(lexer, true)) {
+			return false;
+		}
+		lexer->result_symbol = OPAQUE_BODY;
+		return true;
+	}
+	if (!scan_balanced(lexer, false)) {
+		return false;
+	}
+	lexer->result_symbol = OPAQUE_INITIALIZER;
+	return true;
+}
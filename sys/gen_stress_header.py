@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: LGPL-3.0-only
+
+""" Portable python script to generate the parametrized stress headers for benchmarks """
+
+import argparse
+import sys
+
+
+def gen_structs(out, args):
+    for i in range(args.count):
+        out.write("struct S%d {\n" % i)
+        for j in range(args.fields):
+            if j % 4 == 3:
+                out.write("\tchar *f%d;\n" % j)
+            elif j % 4 == 2:
+                out.write("\tint f%d[%d];\n" % (j, j + 1))
+            else:
+                out.write("\tint f%d;\n" % j)
+        out.write("};\n\n")
+
+
+def gen_nesting(out, args):
+    for i in range(args.count):
+        for d in range(args.depth):
+            out.write("\t" * d + "struct N%d_%d {\n" % (i, d))
+            out.write("\t" * (d + 1) + "int a%d;\n" % d)
+        for d in reversed(range(args.depth)):
+            out.write("\t" * (d + 1) + "float b%d;\n" % d)
+            out.write("\t" * d + ("};\n\n" if d == 0 else "} n%d;\n" % d))
+
+
+def gen_enums(out, args):
+    for i in range(args.count):
+        out.write("enum E%d {\n" % i)
+        for j in range(args.fields):
+            out.write("\tE%d_M%d = %d,\n" % (i, j, j * 2))
+        out.write("};\n\n")
+
+
+def gen_bitfields(out, args):
+    for i in range(args.count):
+        out.write("struct B%d {\n" % i)
+        for j in range(args.fields):
+            out.write("\tint b%d : %d;\n" % (j, j % 7 + 1))
+        out.write("};\n\n")
+
+
+def gen_typedefs(out, args):
+    for i in range(args.count):
+        out.write("typedef int T%d_0;\n" % i)
+        for d in range(1, args.depth):
+            out.write("typedef T%d_%d T%d_%d;\n" % (i, d - 1, i, d))
+        out.write("\n")
+
+
+def gen_anonymous(out, args):
+    # Identical anonymous shapes, should collapse into few records
+    for i in range(args.count):
+        out.write("typedef struct {\n")
+        for j in range(args.fields):
+            out.write("\tint f%d;\n" % (j + i % 4))
+        out.write("} A%d;\n\n" % i)
+
+
+def nested_declarator(name, depth):
+    # Applied inside out, e.g. "int (*(*(*x)[4])(int))[8];", the cycle
+    # never yields arrays of functions nor functions returning them
+    decl = name
+    ops = ["pointer", "array", "pointer", "function"]
+    for d in range(depth):
+        op = ops[d % len(ops)]
+        if op == "pointer":
+            decl = "*" + decl
+        else:
+            if decl.startswith("*"):
+                decl = "(%s)" % decl
+            decl += "[%d]" % (d + 1) if op == "array" else "(int)"
+    # Members can't be functions, only pointers to them
+    if ops[(depth - 1) % len(ops)] == "function":
+        decl = "*" + decl
+    return decl
+
+
+def gen_declarators(out, args):
+    for i in range(args.count):
+        out.write("struct D%d {\n" % i)
+        for j in range(args.fields):
+            out.write("\tint %s;\n" % nested_declarator("d%d" % j, j % args.depth + 1))
+        out.write("};\n\n")
+
+
+def gen_bodies(out, args):
+    # Code heavy source, the declarations are a small part of it
+    for i in range(args.count):
+        out.write("struct F%d {\n\tint a;\n\tchar *b;\n};\n\n" % i)
+        values = ", ".join(str(j * 3) for j in range(args.fields))
+        out.write("static const int table%d[] = { %s };\n\n" % (i, values))
+        out.write("int f%d(struct F%d *p, int n) {\n" % (i, i))
+        out.write("\tint sum = 0;\n")
+        for j in range(args.fields):
+            out.write("\tfor (int k = 0; k < n; k++) {\n")
+            out.write("\t\tif (p->a > %d && table%d[%d] != k) {\n" % (j, i, j))
+            out.write("\t\t\tsum += p->a * %d + (int)p->b[k];\n" % j)
+            out.write("\t\t} else {\n")
+            out.write("\t\t\tsum -= table%d[k %% %d];\n" % (i, args.fields))
+            out.write("\t\t}\n")
+            out.write("\t}\n")
+        out.write("\treturn sum;\n}\n\n")
+
+
+generators = {
+    "structs": gen_structs,
+    "nesting": gen_nesting,
+    "enums": gen_enums,
+    "bitfields": gen_bitfields,
+    "typedefs": gen_typedefs,
+    "anonymous": gen_anonymous,
+    "declarators": gen_declarators,
+    "bodies": gen_bodies,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--kind", choices=sorted(generators.keys()), required=True)
+    parser.add_argument("--count", type=int, default=1000, help="number of types")
+    parser.add_argument("--fields", type=int, default=16, help="fields per type")
+    parser.add_argument("--depth", type=int, default=8, help="nesting or typedef chain depth")
+    parser.add_argument("-o", "--output", default="-")
+    args = parser.parse_args()
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w")
+    out.write("/* Generated by gen_stress_header.py --kind %s */\n\n" % args.kind)
+    generators[args.kind](out, args)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
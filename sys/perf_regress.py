@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: LGPL-3.0-only
+
+""" Portable python script to check the parser performance against the recorded baseline """
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+BASELINE_VERSION = 1
+STAT_RE = {
+    "instructions": re.compile(r"^\s*instructions:\s+(\d+)", re.M),
+    "peak_rss_kb": re.compile(r"^\s*peak rss:\s+(\d+) KB", re.M),
+}
+
+
+def measure(exe, path, runs):
+    times = []
+    samples = {key: [] for key in STAT_RE}
+    for _ in range(runs):
+        start = time.perf_counter()
+        proc = subprocess.run(
+            [exe, "--stats", path],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            universal_newlines=True,
+        )
+        times.append(time.perf_counter() - start)
+        if proc.returncode < 0:
+            raise RuntimeError("crashed with signal %d" % -proc.returncode)
+        if proc.returncode:
+            raise RuntimeError("exited with %d" % proc.returncode)
+        for key, regex in STAT_RE.items():
+            m = regex.search(proc.stdout)
+            if m:
+                samples[key].append(int(m.group(1)))
+    result = {"wall_ms": statistics.median(times) * 1000.0}
+    for key, values in samples.items():
+        if values:
+            result[key] = statistics.median(values)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--exe", required=True, help="ts-c-cpp-parser executable")
+    parser.add_argument("--baseline", required=True, help="baseline JSON file")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument(
+        "--threshold", type=float, default=10.0, help="allowed regression, percent"
+    )
+    parser.add_argument(
+        "--update", action="store_true", help="record the results as the new baseline"
+    )
+    parser.add_argument("inputs", nargs="+")
+    args = parser.parse_args()
+
+    baseline = {"version": BASELINE_VERSION, "inputs": {}}
+    if os.path.isfile(args.baseline):
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+        if baseline.get("version") != BASELINE_VERSION:
+            print("Unsupported baseline version in %s" % args.baseline)
+            sys.exit(1)
+    elif not args.update:
+        # Only the parser failures are checked until a baseline is recorded
+        print("No baseline in %s, record it with `meson compile -C <builddir> perf-baseline`" % args.baseline)
+
+    failed = False
+    missing = False
+    for path in args.inputs:
+        # Generated headers live in the build directory, so
+        # only the file name identifies them
+        name = os.path.basename(path)
+        try:
+            result = measure(args.exe, path, args.runs)
+        except RuntimeError as e:
+            print("%-24s FAILED: %s" % (name, e))
+            failed = True
+            continue
+        base = baseline["inputs"].get(name)
+        line = "%-24s %10.3f ms" % (name, result["wall_ms"])
+        if "instructions" in result:
+            line += " %14d instructions" % result["instructions"]
+        if "peak_rss_kb" in result:
+            line += " %8d KB" % result["peak_rss_kb"]
+        if args.update:
+            baseline["inputs"][name] = result
+        elif not base:
+            # Baselines are machine specific, so the inputs are only
+            # checked once recorded on the reference machine
+            line += "  (no baseline, skipped)"
+            missing = True
+        else:
+            for key, value in sorted(result.items()):
+                if key not in base or not base[key]:
+                    continue
+                change = (value - base[key]) * 100.0 / base[key]
+                if change > args.threshold:
+                    line += "  REGRESSION %s %+.1f%%" % (key, change)
+                    failed = True
+        print(line)
+
+    if args.update and failed:
+        print("Baseline not written, the parser failed on some inputs")
+    elif args.update:
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Baseline written to %s" % args.baseline)
+    elif missing:
+        print("Warning: some inputs were not checked, record them with `meson compile -C <builddir> perf-baseline`")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
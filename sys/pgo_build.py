@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: LGPL-3.0-only
+
+""" Portable python script to build the profile-guided, link-time-optimized release of the parser """
+
+import argparse
+import os
+import subprocess
+import sys
+
+
+def meson(meson_cmd, *args):
+    cmd = meson_cmd + list(args)
+    print("+ " + " ".join(cmd))
+    if subprocess.run(cmd).returncode != 0:
+        sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("builddir", help="meson build directory, created if missing")
+    parser.add_argument("--meson", default="meson", help="meson command")
+    parser.add_argument(
+        "--no-benchmark", action="store_true", help="skip the regression benchmark of the result"
+    )
+    parser.add_argument(
+        "options", nargs="*", help="additional meson options, e.g. -Dcpp_grammar=false"
+    )
+    args = parser.parse_args()
+
+    meson_cmd = args.meson.split()
+    source_root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    release = ["-Dbuildtype=release", "-Db_lto=true", "-Db_ndebug=true"]
+
+    # Instrumented build, trained on the test and the stress corpus
+    if os.path.isfile(os.path.join(args.builddir, "build.ninja")):
+        meson(meson_cmd, "configure", args.builddir, "-Db_pgo=generate", *(release + args.options))
+    else:
+        meson(meson_cmd, "setup", args.builddir, source_root, "-Db_pgo=generate", *(release + args.options))
+    meson(meson_cmd, "compile", "-C", args.builddir)
+    meson(meson_cmd, "compile", "-C", args.builddir, "pgo-train")
+
+    # Optimized build from the recorded profile
+    meson(meson_cmd, "configure", args.builddir, "-Db_pgo=use")
+    meson(meson_cmd, "compile", "-C", args.builddir)
+    if not args.no_benchmark:
+        meson(meson_cmd, "test", "-C", args.builddir, "--benchmark", "--suite", "regression")
+
+
+if __name__ == "__main__":
+    main()
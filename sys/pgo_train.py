@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: LGPL-3.0-only
+
+""" Portable python script to run the profile-guided optimization training of the parser """
+
+import argparse
+import glob
+import os
+import shutil
+import subprocess
+import sys
+
+
+def train(exe, path, runs, env):
+    for _ in range(runs):
+        proc = subprocess.run(
+            [exe, "--stats", path],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            env=env,
+        )
+        if proc.returncode < 0:
+            raise RuntimeError("%s crashed with signal %d" % (path, -proc.returncode))
+
+
+def merge_llvm_profiles(build_root):
+    # GCC updates the .gcda files next to the objects by itself,
+    # clang leaves raw profiles to be merged where -fprofile-use
+    # looks for them
+    raw = glob.glob(os.path.join(build_root, "pgo-*.profraw"))
+    if not raw:
+        return True
+    profdata = shutil.which("llvm-profdata")
+    if not profdata:
+        print("llvm-profdata not found, cannot merge the clang profiles")
+        return False
+    output = os.path.join(build_root, "default.profdata")
+    proc = subprocess.run([profdata, "merge", "-o", output] + raw)
+    if proc.returncode != 0:
+        return False
+    for path in raw:
+        os.remove(path)
+    print("Profile written to %s" % output)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--exe", required=True, help="instrumented ts-c-cpp-parser executable")
+    parser.add_argument("--build-root", required=True, help="meson build directory")
+    parser.add_argument("--runs", type=int, default=1, help="passes over every input")
+    parser.add_argument("inputs", nargs="+")
+    args = parser.parse_args()
+
+    env = dict(os.environ)
+    env["LLVM_PROFILE_FILE"] = os.path.join(args.build_root, "pgo-%p-%m.profraw")
+    for path in args.inputs:
+        print("Training on %s" % os.path.basename(path))
+        train(args.exe, path, args.runs, env)
+    sys.exit(0 if merge_llvm_profiles(args.build_root) else 1)
+
+
+if __name__ == "__main__":
+    main()
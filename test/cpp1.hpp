@@ -0,0 +1,32 @@
+namespace geo {
+
+struct Point {
+   int x;
+   int y;
+};
+
+class Shape {
+public:
+   virtual ~Shape();
+   virtual int area() const = 0;
+protected:
+   Point origin;
+   unsigned int flags : 4;
+};
+
+class Rect : public Shape {
+   int w;
+   int h;
+public:
+   int area() const;
+};
+
+template <typename T>
+struct Pair {
+   T first;
+   T second;
+};
+
+using PointPtr = Point *;
+
+}
@@ -0,0 +1,2 @@
+/* Redefines a typedef the corpus refers to by value, see t1.h */
+typedef unsigned long long uint32_t;
@@ -2,6 +2,7 @@
 typedef uint32_t easy_prey;
 typedef easy_prey humans;
 typedef struct dangerous days;
+typedef char *const cstr;
 
 typedef struct dangerous {
 	uint64_t neo;
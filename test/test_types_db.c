@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+
+#include <types_db.h>
+
+// Versions of the persistent type database, checked against the expected
+// contents. Built twice by meson, once with the hashes narrowed to a few
+// values by C_TYPE_DB_HASH_MASK, so most of the keys end up in the
+// collision nodes below the last level of the trie
+
+#define TEST_TYPES 200
+
+static int failures = 0;
+
+#define check(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+// Struct "S<i>" with a single field, the version is its array size,
+// so the structs of different versions are not equal
+static CType *struct_new(int i, int version) {
+	char name[32];
+	snprintf(name, sizeof(name), "S%d", i);
+	CType *type = c_type_new(C_TYPE_KIND_STRUCT, name);
+	if (!type) {
+		return NULL;
+	}
+	CTypeMember member = { .name = strdup("f"), .type = strdup("int"), .array = version };
+	rz_vector_push(&type->members, &member);
+	type->hash = c_type_hash(type);
+	return type;
+}
+
+static const char *struct_key(int i) {
+	static char key[32];
+	snprintf(key, sizeof(key), "struct S%d", i);
+	return key;
+}
+
+// 0 for an absent type
+static int struct_version(CTypeDb *db, int i) {
+	const CType *type = c_type_db_find(db, struct_key(i));
+	if (!type) {
+		return 0;
+	}
+	const CTypeMember *member = rz_vector_index_ptr((RzVector *)&type->members, 0);
+	return member->array;
+}
+
+static void check_versions(CTypeDb *db, const int *versions) {
+	ut32 count = 0;
+	int i;
+	for (i = 0; i < TEST_TYPES; i++) {
+		check(struct_version(db, i) == versions[i]);
+		count += versions[i] != 0;
+	}
+	check(c_type_db_count(db) == count);
+}
+
+typedef struct {
+	int reported[TEST_TYPES]; // Diff callbacks per type
+	int added;
+	int removed;
+	int replaced;
+} DiffCounts;
+
+static void count_diff(void *user, const char *key, const CType *old_type, const CType *new_type) {
+	DiffCounts *counts = user;
+	int i;
+	if (sscanf(key, "struct S%d", &i) != 1 || i < 0 || i >= TEST_TYPES) {
+		failures++;
+		return;
+	}
+	counts->reported[i]++;
+	if (!old_type) {
+		counts->added++;
+	} else if (!new_type) {
+		counts->removed++;
+	} else {
+		counts->replaced++;
+	}
+}
+
+static void test_snapshot_diff(void) {
+	static int old_versions[TEST_TYPES];
+	static int new_versions[TEST_TYPES];
+	CTypeDb *db = c_type_db_new();
+	check(db);
+	if (!db) {
+		return;
+	}
+	int i;
+	for (i = 0; i < TEST_TYPES; i += 2) {
+		check(c_type_db_set(db, struct_new(i, 1)));
+		old_versions[i] = 1;
+	}
+	check_versions(db, old_versions);
+
+	CTypeDb *old = c_type_db_snapshot(db);
+	check(old);
+	if (!old) {
+		c_type_db_free(db);
+		return;
+	}
+	memcpy(new_versions, old_versions, sizeof(new_versions));
+	int added = 0, removed = 0, replaced = 0;
+	for (i = 0; i < TEST_TYPES; i++) {
+		switch (i % 6) {
+		case 0:
+			// Removed, then defined again as it was
+			check(c_type_db_remove(db, struct_key(i)));
+			check(c_type_db_set(db, struct_new(i, 1)));
+			break;
+		case 1:
+		case 3:
+			check(c_type_db_set(db, struct_new(i, 1)));
+			new_versions[i] = 1;
+			added++;
+			break;
+		case 2:
+			check(c_type_db_set(db, struct_new(i, 2)));
+			new_versions[i] = 2;
+			replaced++;
+			break;
+		case 4:
+			check(c_type_db_remove(db, struct_key(i)));
+			new_versions[i] = 0;
+			removed++;
+			break;
+		default:
+			check(!c_type_db_remove(db, struct_key(i)));
+			break;
+		}
+	}
+	// Repeated definitions keep the stored records
+	check(c_type_db_set(db, struct_new(2, 2)));
+
+	check_versions(db, new_versions);
+	check_versions(old, old_versions);
+
+	DiffCounts counts = { 0 };
+	c_type_db_diff(old, db, count_diff, &counts);
+	check(counts.added == added);
+	check(counts.removed == removed);
+	check(counts.replaced == replaced);
+	for (i = 0; i < TEST_TYPES; i++) {
+		check(counts.reported[i] == (old_versions[i] != new_versions[i]));
+	}
+
+	// The older version outlives the newer one
+	c_type_db_free(db);
+	check_versions(old, old_versions);
+	c_type_db_free(old);
+}
+
+static void test_remove_all(void) {
+	static int versions[TEST_TYPES];
+	CTypeDb *db = c_type_db_new();
+	check(db);
+	if (!db) {
+		return;
+	}
+	int i;
+	for (i = 0; i < TEST_TYPES; i++) {
+		check(c_type_db_set(db, struct_new(i, 1)));
+	}
+	CTypeDb *full = c_type_db_snapshot(db);
+	check(full);
+	for (i = 0; i < TEST_TYPES; i++) {
+		check(c_type_db_remove(db, struct_key(i)));
+	}
+	check_versions(db, versions);
+	CTypeDbStats stats;
+	c_type_db_stats(db, &stats);
+	check(stats.types == 0);
+	check(stats.nodes == 1);
+
+	DiffCounts counts = { 0 };
+	if (full) {
+		c_type_db_diff(full, db, count_diff, &counts);
+		c_type_db_free(full);
+	}
+	check(counts.removed == TEST_TYPES);
+	check(counts.added == 0 && counts.replaced == 0);
+	c_type_db_free(db);
+}
+
+int main(int argc, char **argv) {
+	test_snapshot_diff();
+	test_remove_all();
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
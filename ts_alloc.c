@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_util/rz_assert.h>
+
+#include <ts_alloc.h>
+
+// Pool allocator for the vendored tree-sitter. When built with the
+// allocation recording hooks, tree-sitter routes ts_malloc() and friends
+// to the ts_record_*() functions below instead of the system malloc.
+//
+// Small blocks are carved from the 64KB slabs in 16 byte size classes
+// and recycled through the per-class free lists, so the subtrees of
+// thousands of parses reuse the same memory instead of fragmenting the
+// heap. Every thread has its own pool, thus no locking is needed. A block
+// freed by another thread just joins the free list of that thread.
+// Slabs are never returned, the pool size is bounded by the peak usage.
+
+#define POOL_ALIGN 16
+#define POOL_CLASSES 32 // Up to 512 bytes
+#define POOL_MAX_SIZE (POOL_CLASSES * POOL_ALIGN)
+#define POOL_SLAB_SIZE 0x10000
+#define POOL_LARGE UT32_MAX
+
+#if defined(_MSC_VER)
+#define POOL_THREAD_LOCAL __declspec(thread)
+#else
+#define POOL_THREAD_LOCAL __thread
+#endif
+
+// Precedes every block, keeps the payload aligned
+typedef struct {
+	ut32 size_class; // POOL_LARGE if allocated with malloc
+	ut32 pad;
+	size_t size; // Requested size
+} PoolHeader;
+
+typedef struct pool_block_t {
+	struct pool_block_t *next;
+} PoolBlock;
+
+typedef struct {
+	PoolBlock *free[POOL_CLASSES];
+	ut8 *slab; // Current slab, carved from the start
+	size_t slab_used;
+	CTsAllocStats stats;
+	bool recording;
+} Pool;
+
+static POOL_THREAD_LOCAL Pool pool = { .recording = true };
+
+static void *pool_fail(size_t size) {
+	// Same as the default tree-sitter allocator, which cannot recover
+	eprintf("tree-sitter failed to allocate %zu bytes\n", size);
+	abort();
+	return NULL;
+}
+
+static void pool_account_alloc(size_t size) {
+	pool.stats.allocs++;
+	pool.stats.live_bytes += size;
+	if (pool.stats.live_bytes > pool.stats.peak_bytes) {
+		pool.stats.peak_bytes = pool.stats.live_bytes;
+	}
+}
+
+static void *pool_alloc(size_t size) {
+	if (size > POOL_MAX_SIZE) {
+		PoolHeader *header = malloc(sizeof(PoolHeader) + size);
+		if (!header) {
+			return pool_fail(size);
+		}
+		header->size_class = POOL_LARGE;
+		header->size = size;
+		pool.stats.large++;
+		pool_account_alloc(size);
+		return header + 1;
+	}
+	ut32 size_class = size ? (size - 1) / POOL_ALIGN : 0;
+	PoolHeader *header;
+	PoolBlock *block = pool.free[size_class];
+	if (block) {
+		pool.free[size_class] = block->next;
+		header = (PoolHeader *)block - 1;
+		pool.stats.reused++;
+	} else {
+		size_t block_size = sizeof(PoolHeader) + (size_class + 1) * POOL_ALIGN;
+		if (!pool.slab || pool.slab_used + block_size > POOL_SLAB_SIZE) {
+			// The tail of the previous slab is left unused
+			pool.slab = malloc(POOL_SLAB_SIZE);
+			if (!pool.slab) {
+				return pool_fail(size);
+			}
+			pool.slab_used = 0;
+			pool.stats.pool_bytes += POOL_SLAB_SIZE;
+		}
+		header = (PoolHeader *)(pool.slab + pool.slab_used);
+		pool.slab_used += block_size;
+	}
+	header->size_class = size_class;
+	header->size = size;
+	pool_account_alloc(size);
+	return header + 1;
+}
+
+static void pool_free(void *ptr) {
+	if (!ptr) {
+		return;
+	}
+	PoolHeader *header = (PoolHeader *)ptr - 1;
+	pool.stats.frees++;
+	pool.stats.live_bytes -= RZ_MIN(header->size, pool.stats.live_bytes);
+	if (header->size_class == POOL_LARGE) {
+		free(header);
+		return;
+	}
+	PoolBlock *block = ptr;
+	block->next = pool.free[header->size_class];
+	pool.free[header->size_class] = block;
+}
+
+void *ts_record_malloc(size_t size) {
+	return pool_alloc(size);
+}
+
+void *ts_record_calloc(size_t count, size_t size) {
+	if (size && count > SIZE_MAX / size) {
+		return pool_fail(SIZE_MAX);
+	}
+	void *ptr = pool_alloc(count * size);
+	memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void *ts_record_realloc(void *ptr, size_t size) {
+	if (!ptr) {
+		return pool_alloc(size);
+	}
+	pool.stats.reallocs++;
+	PoolHeader *header = (PoolHeader *)ptr - 1;
+	if (header->size_class != POOL_LARGE && size && (size - 1) / POOL_ALIGN == header->size_class) {
+		// Still fits the same block
+		pool.stats.live_bytes += size;
+		pool.stats.live_bytes -= RZ_MIN(header->size, pool.stats.live_bytes);
+		header->size = size;
+		return ptr;
+	}
+	void *result = pool_alloc(size);
+	memcpy(result, ptr, RZ_MIN(header->size, size));
+	pool_free(ptr);
+	return result;
+}
+
+void ts_record_free(void *ptr) {
+	pool_free(ptr);
+}
+
+// Used by the tree-sitter tests to scope their leak checks, the flag is
+// only kept for them, since the pool serves all the allocations anyway
+bool ts_toggle_allocation_recording(bool value) {
+	bool previous = pool.recording;
+	pool.recording = value;
+	return previous;
+}
+
+// Counters of the calling thread
+void c_ts_alloc_stats(CTsAllocStats *stats) {
+	rz_return_if_fail(stats);
+	*stats = pool.stats;
+}
+
+// Counters of another thread, the peaks are summed as well, so the
+// peak of the threads running at once is overestimated
+void c_ts_alloc_stats_add(CTsAllocStats *stats, const CTsAllocStats *other) {
+	rz_return_if_fail(stats && other);
+	stats->allocs += other->allocs;
+	stats->frees += other->frees;
+	stats->reallocs += other->reallocs;
+	stats->large += other->large;
+	stats->live_bytes += other->live_bytes;
+	stats->peak_bytes += other->peak_bytes;
+	stats->pool_bytes += other->pool_bytes;
+	stats->reused += other->reused;
+}
@@ -0,0 +1,25 @@
+#ifndef TS_ALLOC_H
+#define TS_ALLOC_H
+
+#include <rz_types.h>
+
+// Allocator of the vendored tree-sitter, built with the
+// `ts_arena` option, see ts_record_malloc(). The counters are kept
+// per thread, as the pools are, so the parallel workers copy theirs
+// before exiting. The slabs of a pool stay allocated after its thread
+// exits, thus the pool bytes of the workers are retained for good
+typedef struct {
+	ut64 allocs;
+	ut64 frees;
+	ut64 reallocs;
+	ut64 large; // Allocations too big for the pool, served by malloc
+	ut64 live_bytes; // Requested bytes not freed yet
+	ut64 peak_bytes;
+	ut64 pool_bytes; // Slabs owned by the pool
+	ut64 reused; // Allocations served from the free lists
+} CTsAllocStats;
+
+void c_ts_alloc_stats(CTsAllocStats *stats);
+void c_ts_alloc_stats_add(CTsAllocStats *stats, const CTsAllocStats *other);
+
+#endif
@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_assert.h>
+
+#include <types_db.h>
+
+#define DB_SLOTS (1 << C_TYPE_DB_BITS)
+#define DB_HASH_BITS 64 // Deeper records share the whole hash, see DbNode.collision
+
+// Tests narrow the hashes to reach the collision nodes
+#ifndef C_TYPE_DB_HASH_MASK
+#define C_TYPE_DB_HASH_MASK UT64_MAX
+#endif
+
+// Shared by the nodes of all the versions, never modified once stored
+typedef struct {
+	_Atomic(ut32) refs;
+	ut64 hash;
+	char *key; // e.g. "struct S1"
+	CType *type;
+} DbRecord;
+
+typedef struct db_node_t {
+	_Atomic(ut32) refs; // Versions and parent nodes pointing to the node
+	ut32 datamap; // Slots holding a record
+	ut32 nodemap; // Slots holding a child node
+	ut32 count;
+	bool collision; // Records of the same hash below the last level, no maps
+	void *entries[]; // Records first, then the child nodes, both in the slot order
+} DbNode;
+
+struct c_type_db_t {
+	DbNode *root;
+	ut32 count;
+};
+
+typedef struct {
+	CTypeDbDiffCb cb;
+	void *user;
+} DbDiff;
+
+// Every level of the trie takes the next bits
+static ut64 key_hash(const char *key) {
+	return c_type_key_hash(key) & C_TYPE_DB_HASH_MASK;
+}
+
+static ut32 bit_count(ut32 x) {
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static ut32 hash_bit(ut64 hash, ut32 shift) {
+	return 1u << ((hash >> shift) & (DB_SLOTS - 1));
+}
+
+static ut32 data_count(const DbNode *node) {
+	return node->collision ? node->count : bit_count(node->datamap);
+}
+
+static ut32 data_index(const DbNode *node, ut32 bit) {
+	return bit_count(node->datamap & (bit - 1));
+}
+
+static ut32 node_index(const DbNode *node, ut32 bit) {
+	return bit_count(node->datamap) + bit_count(node->nodemap & (bit - 1));
+}
+
+static bool record_is(const DbRecord *record, ut64 hash, const char *key) {
+	return record->hash == hash && !strcmp(record->key, key);
+}
+
+static DbRecord *record_new(char *key, CType *type) {
+	DbRecord *record = RZ_NEW0(DbRecord);
+	if (!record) {
+		return NULL;
+	}
+	atomic_init(&record->refs, 1);
+	record->hash = key_hash(key);
+	record->key = key;
+	record->type = type;
+	return record;
+}
+
+static DbRecord *record_ref(DbRecord *record) {
+	atomic_fetch_add_explicit(&record->refs, 1, memory_order_relaxed);
+	return record;
+}
+
+static void record_unref(DbRecord *record) {
+	if (atomic_fetch_sub_explicit(&record->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+	c_type_free(record->type);
+	free(record->key);
+	free(record);
+}
+
+static DbNode *node_alloc(ut32 count) {
+	DbNode *node = calloc(1, sizeof(DbNode) + count * sizeof(void *));
+	if (!node) {
+		return NULL;
+	}
+	atomic_init(&node->refs, 1);
+	node->count = count;
+	return node;
+}
+
+static void node_unref(DbNode *node) {
+	if (atomic_fetch_sub_explicit(&node->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+	ut32 i, data = data_count(node);
+	for (i = 0; i < node->count; i++) {
+		if (i < data) {
+			record_unref(node->entries[i]);
+		} else {
+			node_unref(node->entries[i]);
+		}
+	}
+	free(node);
+}
+
+static void entry_ref(DbNode *node, ut32 i) {
+	if (i < data_count(node)) {
+		record_ref(node->entries[i]);
+	} else {
+		atomic_fetch_add_explicit(&((DbNode *)node->entries[i])->refs, 1, memory_order_relaxed);
+	}
+}
+
+// The copy takes over the place of the node: the entries taken from the
+// node get their own references, the fresh one already holds one
+static DbNode *node_replace(DbNode *node, DbNode *copy, void *fresh) {
+	ut32 i;
+	for (i = 0; i < copy->count; i++) {
+		if (copy->entries[i] != fresh) {
+			entry_ref(copy, i);
+		}
+	}
+	node_unref(node);
+	return copy;
+}
+
+// Returns the node when only the changed version reaches it, otherwise
+// a copy to change. The caller drops the node once the copy is complete
+static DbNode *node_writable(DbNode *node, bool owned) {
+	if (owned) {
+		return node;
+	}
+	DbNode *copy = node_alloc(node->count);
+	if (!copy) {
+		return NULL;
+	}
+	copy->datamap = node->datamap;
+	copy->nodemap = node->nodemap;
+	copy->collision = node->collision;
+	memcpy(copy->entries, node->entries, node->count * sizeof(void *));
+	ut32 i;
+	for (i = 0; i < copy->count; i++) {
+		entry_ref(copy, i);
+	}
+	return copy;
+}
+
+// Node without the entry at the index
+static DbNode *node_drop(DbNode *node, ut32 index, ut32 datamap, ut32 nodemap) {
+	DbNode *copy = node_alloc(node->count - 1);
+	if (!copy) {
+		return NULL;
+	}
+	copy->datamap = datamap;
+	copy->nodemap = nodemap;
+	copy->collision = node->collision;
+	memcpy(copy->entries, node->entries, index * sizeof(void *));
+	memcpy(copy->entries + index, node->entries + index + 1, (node->count - index - 1) * sizeof(void *));
+	return node_replace(node, copy, NULL);
+}
+
+static DbNode *node_put(DbNode *node, bool owned, ut32 index, DbRecord *record) {
+	DbNode *copy = node_writable(node, owned);
+	if (!copy) {
+		return NULL;
+	}
+	record_unref(copy->entries[index]);
+	copy->entries[index] = record_ref(record);
+	if (copy != node) {
+		node_unref(node);
+	}
+	return copy;
+}
+
+// Child holding two records of different keys
+static DbNode *node_pair(DbRecord *a, DbRecord *b, ut32 shift) {
+	DbNode *node;
+	if (shift >= DB_HASH_BITS) {
+		node = node_alloc(2);
+		if (!node) {
+			return NULL;
+		}
+		node->collision = true;
+		node->entries[0] = record_ref(a);
+		node->entries[1] = record_ref(b);
+		return node;
+	}
+	ut32 bit_a = hash_bit(a->hash, shift);
+	ut32 bit_b = hash_bit(b->hash, shift);
+	if (bit_a == bit_b) {
+		DbNode *child = node_pair(a, b, shift + C_TYPE_DB_BITS);
+		if (!child) {
+			return NULL;
+		}
+		node = node_alloc(1);
+		if (!node) {
+			node_unref(child);
+			return NULL;
+		}
+		node->nodemap = bit_a;
+		node->entries[0] = child;
+		return node;
+	}
+	node = node_alloc(2);
+	if (!node) {
+		return NULL;
+	}
+	node->datamap = bit_a | bit_b;
+	node->entries[bit_a < bit_b ? 0 : 1] = record_ref(a);
+	node->entries[bit_a < bit_b ? 1 : 0] = record_ref(b);
+	return node;
+}
+
+// Returns the node to take the place of the given one, which gives up its
+// reference, or NULL on failure, leaving the subtree as it was. Only the
+// nodes reached through the nodes of a single reference are changed in place
+static DbNode *node_set(DbNode *node, bool owned, ut32 shift, DbRecord *record) {
+	owned = owned && atomic_load_explicit(&node->refs, memory_order_acquire) == 1;
+	DbNode *copy;
+	ut32 i;
+	if (node->collision) {
+		for (i = 0; i < node->count; i++) {
+			if (!strcmp(((DbRecord *)node->entries[i])->key, record->key)) {
+				return node_put(node, owned, i, record);
+			}
+		}
+		copy = node_alloc(node->count + 1);
+		if (!copy) {
+			return NULL;
+		}
+		copy->collision = true;
+		memcpy(copy->entries, node->entries, node->count * sizeof(void *));
+		copy->entries[node->count] = record_ref(record);
+		return node_replace(node, copy, record);
+	}
+	ut32 bit = hash_bit(record->hash, shift);
+	if (node->datamap & bit) {
+		i = data_index(node, bit);
+		DbRecord *stored = node->entries[i];
+		if (record_is(stored, record->hash, record->key)) {
+			return node_put(node, owned, i, record);
+		}
+		// Both records move one level down
+		DbNode *child = node_pair(stored, record, shift + C_TYPE_DB_BITS);
+		if (!child) {
+			return NULL;
+		}
+		copy = node_alloc(node->count);
+		if (!copy) {
+			node_unref(child);
+			return NULL;
+		}
+		copy->datamap = node->datamap & ~bit;
+		copy->nodemap = node->nodemap | bit;
+		ut32 at = node_index(copy, bit);
+		ut32 j = 0, k;
+		for (k = 0; k < node->count; k++) {
+			if (k == i) {
+				continue;
+			}
+			if (j == at) {
+				copy->entries[j++] = child;
+			}
+			copy->entries[j++] = node->entries[k];
+		}
+		if (j == at) {
+			copy->entries[j] = child;
+		}
+		return node_replace(node, copy, child);
+	}
+	if (node->nodemap & bit) {
+		i = node_index(node, bit);
+		copy = node_writable(node, owned);
+		if (!copy) {
+			return NULL;
+		}
+		DbNode *child = node_set(copy->entries[i], owned, shift + C_TYPE_DB_BITS, record);
+		if (!child) {
+			if (copy != node) {
+				node_unref(copy);
+			}
+			return NULL;
+		}
+		copy->entries[i] = child;
+		if (copy != node) {
+			node_unref(node);
+		}
+		return copy;
+	}
+	copy = node_alloc(node->count + 1);
+	if (!copy) {
+		return NULL;
+	}
+	copy->datamap = node->datamap | bit;
+	copy->nodemap = node->nodemap;
+	i = data_index(copy, bit);
+	memcpy(copy->entries, node->entries, i * sizeof(void *));
+	copy->entries[i] = record_ref(record);
+	memcpy(copy->entries + i + 1, node->entries + i, (node->count - i) * sizeof(void *));
+	return node_replace(node, copy, record);
+}
+
+// Same as node_set(), the key must be stored in the subtree
+static DbNode *node_remove(DbNode *node, bool owned, ut32 shift, ut64 hash, const char *key) {
+	owned = owned && atomic_load_explicit(&node->refs, memory_order_acquire) == 1;
+	ut32 i;
+	if (node->collision) {
+		for (i = 0; i < node->count && strcmp(((DbRecord *)node->entries[i])->key, key); i++) {
+		}
+		return i < node->count ? node_drop(node, i, 0, 0) : node;
+	}
+	ut32 bit = hash_bit(hash, shift);
+	if (node->datamap & bit) {
+		return node_drop(node, data_index(node, bit), node->datamap & ~bit, node->nodemap);
+	}
+	i = node_index(node, bit);
+	DbNode *copy = node_writable(node, owned);
+	if (!copy) {
+		return NULL;
+	}
+	DbNode *child = node_remove(copy->entries[i], owned, shift + C_TYPE_DB_BITS, hash, key);
+	if (!child) {
+		if (copy != node) {
+			node_unref(copy);
+		}
+		return NULL;
+	}
+	copy->entries[i] = child;
+	if (copy != node) {
+		node_unref(node);
+	}
+	if (!child->count) {
+		// Failing to drop the empty child only wastes it
+		DbNode *smaller = node_drop(copy, i, copy->datamap, copy->nodemap & ~bit);
+		return smaller ? smaller : copy;
+	}
+	return copy;
+}
+
+CTypeDb *c_type_db_new(void) {
+	CTypeDb *db = RZ_NEW0(CTypeDb);
+	if (!db) {
+		return NULL;
+	}
+	db->root = node_alloc(0);
+	if (!db->root) {
+		free(db);
+		return NULL;
+	}
+	return db;
+}
+
+// Frees the version, the records shared with the other versions stay
+void c_type_db_free(CTypeDb *db) {
+	if (!db) {
+		return;
+	}
+	node_unref(db->root);
+	free(db);
+}
+
+// New version equal to the given one, in constant time. The changes of
+// either version are not seen by the other one
+CTypeDb *c_type_db_snapshot(CTypeDb *db) {
+	rz_return_val_if_fail(db, NULL);
+	CTypeDb *snapshot = RZ_NEW0(CTypeDb);
+	if (!snapshot) {
+		return NULL;
+	}
+	atomic_fetch_add_explicit(&db->root->refs, 1, memory_order_relaxed);
+	snapshot->root = db->root;
+	snapshot->count = db->count;
+	return snapshot;
+}
+
+ut32 c_type_db_count(CTypeDb *db) {
+	rz_return_val_if_fail(db, 0);
+	return db->count;
+}
+
+static void node_stats(const DbNode *node, bool shared, CTypeDbStats *stats) {
+	shared = shared || atomic_load_explicit(&node->refs, memory_order_relaxed) > 1;
+	stats->nodes++;
+	stats->shared += shared;
+	ut32 i;
+	for (i = data_count(node); i < node->count; i++) {
+		node_stats(node->entries[i], shared, stats);
+	}
+}
+
+// Walks the whole trie, only consistent while the versions sharing
+// the nodes are not freed
+void c_type_db_stats(CTypeDb *db, CTypeDbStats *stats) {
+	rz_return_if_fail(db && stats);
+	memset(stats, 0, sizeof(*stats));
+	stats->types = db->count;
+	node_stats(db->root, false, stats);
+}
+
+const CType *c_type_db_find(CTypeDb *db, const char *key) {
+	rz_return_val_if_fail(db && key, NULL);
+	ut64 hash = key_hash(key);
+	const DbNode *node = db->root;
+	ut32 shift, i;
+	for (shift = 0;; shift += C_TYPE_DB_BITS) {
+		if (node->collision) {
+			for (i = 0; i < node->count; i++) {
+				const DbRecord *record = node->entries[i];
+				if (!strcmp(record->key, key)) {
+					return record->type;
+				}
+			}
+			return NULL;
+		}
+		ut32 bit = hash_bit(hash, shift);
+		if (node->datamap & bit) {
+			const DbRecord *record = node->entries[data_index(node, bit)];
+			return record_is(record, hash, key) ? record->type : NULL;
+		}
+		if (!(node->nodemap & bit)) {
+			return NULL;
+		}
+		node = node->entries[node_index(node, bit)];
+	}
+}
+
+static bool node_foreach(const DbNode *node, CTypeDbForeachCb cb, void *user) {
+	ut32 i, data = data_count(node);
+	for (i = 0; i < node->count; i++) {
+		if (i < data) {
+			const DbRecord *record = node->entries[i];
+			if (!cb(user, record->key, record->type)) {
+				return false;
+			}
+		} else if (!node_foreach(node->entries[i], cb, user)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// In the hash order
+void c_type_db_foreach(CTypeDb *db, CTypeDbForeachCb cb, void *user) {
+	rz_return_if_fail(db && cb);
+	node_foreach(db->root, cb, user);
+}
+
+static void diff_report(DbDiff *diff, const DbRecord *old_record, const DbRecord *new_record) {
+	if (old_record && new_record && old_record->type->forward == new_record->type->forward
+		&& c_type_equal(old_record->type, new_record->type)) {
+		// Defined again after a removal
+		return;
+	}
+	diff->cb(diff->user, old_record ? old_record->key : new_record->key,
+		old_record ? old_record->type : NULL, new_record ? new_record->type : NULL);
+}
+
+// Reports the records of the subtree as added, or removed, except the one
+// with the key of the single record, which is compared with it instead.
+// Returns whether the key was found
+static bool diff_subtree(DbDiff *diff, const DbNode *node, const DbRecord *single, bool added) {
+	bool found = false;
+	ut32 i, data = data_count(node);
+	for (i = 0; i < node->count; i++) {
+		if (i >= data) {
+			found |= diff_subtree(diff, node->entries[i], single, added);
+			continue;
+		}
+		const DbRecord *record = node->entries[i];
+		if (single && record_is(record, single->hash, single->key)) {
+			found = true;
+			if (record != single) {
+				diff_report(diff, added ? single : record, added ? record : single);
+			}
+		} else {
+			diff_report(diff, added ? NULL : record, added ? record : NULL);
+		}
+	}
+	return found;
+}
+
+static const DbRecord *collision_find(const DbNode *node, const char *key) {
+	ut32 i;
+	for (i = 0; i < node->count; i++) {
+		const DbRecord *record = node->entries[i];
+		if (!strcmp(record->key, key)) {
+			return record;
+		}
+	}
+	return NULL;
+}
+
+// Both nodes are at the same depth, the subtrees shared by
+// the versions are skipped without being visited
+static void diff_nodes(DbDiff *diff, const DbNode *a, const DbNode *b) {
+	if (a == b) {
+		return;
+	}
+	ut32 i;
+	if (a->collision) {
+		for (i = 0; i < a->count; i++) {
+			const DbRecord *ra = a->entries[i];
+			const DbRecord *rb = collision_find(b, ra->key);
+			if (ra != rb) {
+				diff_report(diff, ra, rb);
+			}
+		}
+		for (i = 0; i < b->count; i++) {
+			const DbRecord *rb = b->entries[i];
+			if (!collision_find(a, rb->key)) {
+				diff_report(diff, NULL, rb);
+			}
+		}
+		return;
+	}
+	for (i = 0; i < DB_SLOTS; i++) {
+		ut32 bit = 1u << i;
+		const DbRecord *ra = a->datamap & bit ? a->entries[data_index(a, bit)] : NULL;
+		const DbRecord *rb = b->datamap & bit ? b->entries[data_index(b, bit)] : NULL;
+		const DbNode *na = a->nodemap & bit ? a->entries[node_index(a, bit)] : NULL;
+		const DbNode *nb = b->nodemap & bit ? b->entries[node_index(b, bit)] : NULL;
+		if (na && nb) {
+			diff_nodes(diff, na, nb);
+		} else if (na) {
+			if (!diff_subtree(diff, na, rb, false) && rb) {
+				diff_report(diff, NULL, rb);
+			}
+		} else if (nb) {
+			if (!diff_subtree(diff, nb, ra, true) && ra) {
+				diff_report(diff, ra, NULL);
+			}
+		} else if (ra != rb) {
+			if (ra && rb && !record_is(ra, rb->hash, rb->key)) {
+				diff_report(diff, ra, NULL);
+				diff_report(diff, NULL, rb);
+			} else {
+				diff_report(diff, ra, rb);
+			}
+		}
+	}
+}
+
+// Reports the types added, removed and replaced since the older version,
+// visiting only the parts of the trie the versions do not share
+void c_type_db_diff(CTypeDb *from, CTypeDb *to, CTypeDbDiffCb cb, void *user) {
+	rz_return_if_fail(from && to && cb);
+	DbDiff diff = { cb, user };
+	diff_nodes(&diff, from->root, to->root);
+}
+
+// Stores the type under its key, taking its ownership. A newer definition
+// replaces the stored one, unlike in the parser state, except the forward
+// declarations and the repeated definitions, which keep the stored record
+// shared. The links to the other types are dropped, since those may be
+// replaced in a newer version: the record stands on its own
+bool c_type_db_set(CTypeDb *db, CType *type) {
+	rz_return_val_if_fail(db && type && type->name, false);
+	char *key = c_type_key(type->kind, type->name);
+	if (!key) {
+		c_type_free(type);
+		return false;
+	}
+	const CType *stored = c_type_db_find(db, key);
+	if (stored && (type->forward || (!stored->forward && c_type_equal(stored, type)))) {
+		c_type_free(type);
+		free(key);
+		return true;
+	}
+	type->canonical = type;
+	type->parent = NULL;
+	CTypeOffset *offset;
+	rz_vector_foreach(&type->offsets, offset) {
+		offset->elem = NULL;
+	}
+	DbRecord *record = record_new(key, type);
+	if (!record) {
+		c_type_free(type);
+		free(key);
+		return false;
+	}
+	DbNode *root = node_set(db->root, true, 0, record);
+	record_unref(record);
+	if (!root) {
+		return false;
+	}
+	db->root = root;
+	db->count += !stored;
+	return true;
+}
+
+bool c_type_db_remove(CTypeDb *db, const char *key) {
+	rz_return_val_if_fail(db && key, false);
+	if (!c_type_db_find(db, key)) {
+		return false;
+	}
+	DbNode *root = node_remove(db->root, true, 0, key_hash(key), key);
+	if (!root) {
+		return false;
+	}
+	db->root = root;
+	db->count--;
+	return true;
+}
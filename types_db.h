@@ -0,0 +1,45 @@
+#ifndef TYPES_DB_H
+#define TYPES_DB_H
+
+#include <rz_types.h>
+
+#include <types_parser.h>
+
+// Persistent type database, a hash array mapped trie of refcounted type
+// records. Every CTypeDb is a version: a snapshot only takes a reference
+// to the root, and the changes copy the path to the changed record, so
+// the versions share all the unchanged nodes and records. The nodes
+// reachable from more than one version are never modified, which keeps
+// the older versions readable by other threads while a newer one is
+// being changed. A single version is changed by one thread at a time.
+
+#define C_TYPE_DB_BITS 5 // Hash bits consumed by every level of the trie
+
+typedef struct c_type_db_t CTypeDb;
+
+typedef struct {
+	ut32 types;
+	ut32 nodes;
+	ut32 shared; // Nodes reachable from other versions too
+} CTypeDbStats;
+
+// Return false to stop the iteration
+typedef bool (*CTypeDbForeachCb)(void *user, const char *key, const CType *type);
+// The old type is NULL for an added type, the new one for a removed type
+typedef void (*CTypeDbDiffCb)(void *user, const char *key, const CType *old_type, const CType *new_type);
+
+CTypeDb *c_type_db_new(void);
+void c_type_db_free(CTypeDb *db);
+CTypeDb *c_type_db_snapshot(CTypeDb *db);
+ut32 c_type_db_count(CTypeDb *db);
+void c_type_db_stats(CTypeDb *db, CTypeDbStats *stats);
+
+// The found types stay valid as long as the version
+const CType *c_type_db_find(CTypeDb *db, const char *key);
+void c_type_db_foreach(CTypeDb *db, CTypeDbForeachCb cb, void *user);
+void c_type_db_diff(CTypeDb *from, CTypeDb *to, CTypeDbDiffCb cb, void *user);
+
+bool c_type_db_set(CTypeDb *db, CType *type);
+bool c_type_db_remove(CTypeDb *db, const char *key);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_assert.h>
+
+#include <types_parser.h>
+
+// Dependencies are indexed by the name the members refer to, rather than
+// by the record, so a type stored later still finds the types waiting
+// for it, e.g. the structs embedding a forward declared one
+
+static RzVector /*<CTypeDep>*/ *dependents_of(CParserState *state, const char *name, bool create) {
+	RzVector *deps = ht_pp_find(state->dependents, name, NULL);
+	if (!deps && create) {
+		deps = rz_vector_new(sizeof(CTypeDep), NULL, NULL);
+		if (deps && !ht_pp_insert(state->dependents, name, deps)) {
+			rz_vector_free(deps);
+			return NULL;
+		}
+	}
+	return deps;
+}
+
+// Made of the C keywords only, e.g. "unsigned int", thus never defined
+// by the inputs. The typedefs like "uint32_t" are, and do get edges
+static bool is_builtin_type(const char *name) {
+	static const char *keywords[] = {
+		"void", "char", "short", "int", "long", "float", "double",
+		"signed", "unsigned", "_Bool", "bool",
+	};
+	const char *word = name;
+	while (*word) {
+		size_t len = strcspn(word, " ");
+		size_t i;
+		for (i = 0; i < RZ_ARRAY_SIZE(keywords); i++) {
+			if (strlen(keywords[i]) == len && !strncmp(keywords[i], word, len)) {
+				break;
+			}
+		}
+		if (i == RZ_ARRAY_SIZE(keywords)) {
+			return false;
+		}
+		word += len;
+		word += strspn(word, " ");
+	}
+	return true;
+}
+
+// Function types have no layout, thus are not worth an edge, neither
+// are the builtin types, which every other member refers to
+static bool member_refers(const CTypeMember *member) {
+	return member->type && !member->function && !is_builtin_type(member->type);
+}
+
+// Records the types the members of the type refer to, one edge per
+// referred name, by value if any of the members embeds it
+bool c_parser_deps_add(CParserState *state, CType *type) {
+	rz_return_val_if_fail(state && type, false);
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		if (!member_refers(member)) {
+			continue;
+		}
+		RzVector *deps = dependents_of(state, member->type, true);
+		if (!deps) {
+			return false;
+		}
+		// Edges of the type are pushed together, a repeated name is the last one
+		CTypeDep *last = rz_vector_empty(deps) ? NULL : rz_vector_tail(deps);
+		if (last && last->type == type) {
+			last->by_value |= !member->pointers;
+			continue;
+		}
+		CTypeDep dep = { .type = type, .by_value = !member->pointers };
+		if (!rz_vector_push(deps, &dep)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Drops the edges of the type before its members are replaced
+void c_parser_deps_remove(CParserState *state, CType *type) {
+	rz_return_if_fail(state && type);
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		if (!member_refers(member)) {
+			continue;
+		}
+		RzVector *deps = dependents_of(state, member->type, false);
+		ut32 i;
+		for (i = 0; deps && i < rz_vector_len(deps); i++) {
+			CTypeDep *dep = rz_vector_index_ptr(deps, i);
+			if (dep->type == type) {
+				rz_vector_remove_at(deps, i, NULL);
+				break;
+			}
+		}
+	}
+}
+
+// Types referring to the name, e.g. "struct S1", NULL if there are none
+const RzVector /*<CTypeDep>*/ *c_parser_type_dependents(CParserState *state, const char *name) {
+	rz_return_val_if_fail(state && name, NULL);
+	return dependents_of(state, name, false);
+}
+
+// Queues the type and everything embedding it by value, directly or
+// through other types, for c_parser_update_layouts(). The types referring
+// to it only by pointer keep their layouts. Typedef aliases embed their
+// type by value, so their compressed resolution paths are dropped too.
+// Nothing is laid out before the first c_parser_compute_layouts(), so
+// there is nothing to invalidate
+bool c_parser_invalidate_type(CParserState *state, CType *type) {
+	rz_return_val_if_fail(state && type, false);
+	if (!state->layouts_computed || type->invalid) {
+		return true;
+	}
+	RzPVector stack;
+	rz_pvector_init(&stack, NULL);
+	bool result = true;
+	void *cur = type;
+	do {
+		CType *dependent = cur;
+		if (dependent->invalid) {
+			continue;
+		}
+		if (!rz_pvector_push(&state->invalid, dependent)) {
+			result = false;
+			break;
+		}
+		dependent->invalid = true;
+		dependent->laid_out = false;
+		dependent->parent = NULL;
+		char *key = c_type_key(dependent->kind, dependent->name);
+		const RzVector *deps = key ? dependents_of(state, key, false) : NULL;
+		free(key);
+		CTypeDep *dep;
+		if (deps) {
+			rz_vector_foreach(deps, dep) {
+				if (dep->by_value && !dep->type->invalid && !rz_pvector_push(&stack, dep->type)) {
+					result = false;
+				}
+			}
+		}
+	} while ((cur = rz_pvector_pop(&stack)));
+	rz_pvector_fini(&stack);
+	return result;
+}
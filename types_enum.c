@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_num.h>
+#include <rz_util/rz_str.h>
+#include <rz_util/rz_strbuf.h>
+#include <rz_util/rz_assert.h>
+#include <rz_util/ht_pu.h>
+
+#include <types_parser.h>
+
+// Dense table is used when it wastes at most that many slots per enumerator
+#define ENUM_DENSE_RATIO 4
+#define ENUM_DENSE_MAX 0x10000
+
+typedef struct {
+	HtPU *values; // Enumerators evaluated so far
+	bool ok;
+} EnumEval;
+
+// Earlier enumerators of the same enum can be referenced, e.g. "B = A << 1".
+// RzNum passes its userptr as the first argument, not itself, and calls
+// the callback for the numeric literals too, so only the identifiers
+// that are not found make the value unresolved
+static ut64 enum_num_callback(RzNum *user, const char *str, int *ok) {
+	EnumEval *eval = (EnumEval *)user;
+	bool found = false;
+	ut64 value = ht_pu_find(eval->values, str, &found);
+	if (!found && (isalpha((ut8)*str) || *str == '_')) {
+		eval->ok = false;
+	}
+	if (ok) {
+		*ok = found;
+	}
+	return value;
+}
+
+// Strips the integer literal suffixes, e.g. "1UL << 3" -> "1 << 3",
+// since RzNum doesn't understand them
+static char *enum_expr_normalize(const char *expr) {
+	char *out = strdup(expr);
+	if (!out) {
+		return NULL;
+	}
+	char *dst = out;
+	const char *src = expr;
+	bool number = false;
+	while (*src) {
+		if (number && strchr("uUlL", *src)) {
+			src++;
+			continue;
+		}
+		if (isalnum((ut8)*src) || *src == '_') {
+			if (!number && isdigit((ut8)*src) && (src == expr || !(isalnum((ut8)src[-1]) || src[-1] == '_'))) {
+				number = true;
+			}
+		} else {
+			number = false;
+		}
+		*dst++ = *src++;
+	}
+	*dst = '\0';
+	return out;
+}
+
+static int enum_value_cmp(const void *a, const void *b) {
+	const CEnumValue *va = a;
+	const CEnumValue *vb = b;
+	if (va->value != vb->value) {
+		return va->value < vb->value ? -1 : 1;
+	}
+	return va->order < vb->order ? -1 : va->order > vb->order;
+}
+
+void c_enum_index_free(CEnumIndex *index) {
+	if (!index) {
+		return;
+	}
+	rz_vector_fini(&index->values);
+	free(index->dense);
+	free(index);
+}
+
+// Evaluates the enumerators, following the C rule that an enumerator
+// without a value is the previous one plus one
+static bool enum_evaluate(CParserState *state, CType *type, CEnumIndex *index) {
+	EnumEval eval = { .values = ht_pu_new0(), .ok = true };
+	if (!eval.values) {
+		return false;
+	}
+	RzNum *num = rz_num_new(enum_num_callback, NULL, &eval);
+	if (!num) {
+		ht_pu_free(eval.values);
+		return false;
+	}
+	ut64 next = 0;
+	ut32 order = 0;
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		ut64 value = next;
+		if (member->value) {
+			char *expr = enum_expr_normalize(member->value);
+			eval.ok = true;
+			value = expr ? rz_num_math(num, expr) : 0;
+			if (!expr || !eval.ok) {
+				index->unresolved++;
+				if (state->verbose) {
+					eprintf("Cannot evaluate enum %s member %s = %s\n", type->name, member->name, member->value);
+				}
+			}
+			free(expr);
+		}
+		CEnumValue entry = { .value = value, .name = member->name, .order = order++ };
+		rz_vector_push(&index->values, &entry);
+		ht_pu_insert(eval.values, member->name, value);
+		next = value + 1;
+	}
+	rz_num_free(num);
+	ht_pu_free(eval.values);
+	return true;
+}
+
+static CEnumIndex *enum_index_build(CParserState *state, CType *type) {
+	CEnumIndex *index = RZ_NEW0(CEnumIndex);
+	if (!index) {
+		return NULL;
+	}
+	rz_vector_init(&index->values, sizeof(CEnumValue), NULL, NULL);
+	if (!enum_evaluate(state, type, index)) {
+		c_enum_index_free(index);
+		return NULL;
+	}
+	CEnumValue *values = rz_vector_head(&index->values);
+	ut32 count = rz_vector_len(&index->values);
+	if (!count) {
+		return index;
+	}
+	qsort(values, count, sizeof(CEnumValue), enum_value_cmp);
+
+	// Single bit enumerators form the flag table,
+	// the first declared one wins on duplicates
+	ut32 i;
+	for (i = 0; i < count; i++) {
+		ut64 value = values[i].value;
+		if (value && !(value & (value - 1))) {
+			int bit = 0;
+			while (!(value & 1)) {
+				value >>= 1;
+				bit++;
+			}
+			if (!index->bits[bit] || index->bits_order[bit] > values[i].order) {
+				index->bits[bit] = values[i].name;
+				index->bits_order[bit] = values[i].order;
+			}
+		}
+	}
+
+	// Compact ranges, the common case of the sequential
+	// enumerators, are looked up directly
+	ut64 range = values[count - 1].value - values[0].value;
+	if (range < ENUM_DENSE_MAX && range < (ut64)count * ENUM_DENSE_RATIO) {
+		index->dense_base = values[0].value;
+		index->dense_count = range + 1;
+		index->dense = RZ_NEWS0(const char *, index->dense_count);
+		if (!index->dense) {
+			index->dense_count = 0;
+			return index;
+		}
+		// Sorted by the declaration order for the same value, thus
+		// walking backwards leaves the first declared name
+		for (i = count; i > 0; i--) {
+			index->dense[values[i - 1].value - index->dense_base] = values[i - 1].name;
+		}
+	}
+	return index;
+}
+
+static CType *enum_type(CParserState *state, CType *type) {
+	if (type->kind == C_TYPE_KIND_TYPEDEF) {
+		type = c_parser_find_type(state, c_parser_canonical_type(state, type->name));
+	}
+	return type && type->kind == C_TYPE_KIND_ENUM && !type->forward ? type : NULL;
+}
+
+// Returns the lookup index of the enum, building it on the first use
+const CEnumIndex *c_parser_enum_index(CParserState *state, CType *type) {
+	rz_return_val_if_fail(state && type, NULL);
+	type = enum_type(state, type);
+	if (!type) {
+		return NULL;
+	}
+	if (!type->enum_index) {
+		type->enum_index = enum_index_build(state, type);
+	}
+	return type->enum_index;
+}
+
+static bool index_enum(void *user, const void *k, const void *v) {
+	CParserState *state = user;
+	CType *type = (CType *)v;
+	if (type->kind == C_TYPE_KIND_ENUM) {
+		c_parser_enum_index(state, type);
+	}
+	return true;
+}
+
+// Precomputes the indexes of all the stored enums
+void c_parser_index_enums(CParserState *state) {
+	rz_return_if_fail(state);
+	ht_pp_foreach(state->types, index_enum, state);
+}
+
+// Returns the first declared enumerator of the value, NULL if there is none
+const char *c_parser_enum_name(CParserState *state, CType *type, ut64 value) {
+	const CEnumIndex *index = c_parser_enum_index(state, type);
+	if (!index) {
+		return NULL;
+	}
+	if (index->dense) {
+		if (value < index->dense_base || value - index->dense_base >= index->dense_count) {
+			return NULL;
+		}
+		return index->dense[value - index->dense_base];
+	}
+	const CEnumValue *values = rz_vector_head((RzVector *)&index->values);
+	ut32 lo = 0, hi = rz_vector_len(&index->values);
+	while (lo < hi) {
+		ut32 mid = lo + (hi - lo) / 2;
+		if (values[mid].value < value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo < rz_vector_len(&index->values) && values[lo].value == value ? values[lo].name : NULL;
+}
+
+// Renders the value as the OR-ed flag names, e.g. "A | C | 0x40", where
+// the bits without a name are kept as a number. An exact match wins over
+// the decomposition, so the masks like "RW = R | W" stay readable.
+char *c_parser_enum_flags(CParserState *state, CType *type, ut64 value) {
+	const CEnumIndex *index = c_parser_enum_index(state, type);
+	if (!index) {
+		return NULL;
+	}
+	const char *name = c_parser_enum_name(state, type, value);
+	if (name) {
+		return strdup(name);
+	}
+	RzStrBuf *sb = rz_strbuf_new("");
+	if (!sb) {
+		return NULL;
+	}
+	ut64 rest = 0;
+	ut64 bits = value;
+	// Proportional to the number of the set bits
+	while (bits) {
+		ut64 bit = bits & -bits;
+		bits &= bits - 1;
+		int n = 0;
+#if defined(__GNUC__) || defined(__clang__)
+		n = __builtin_ctzll(bit);
+#else
+		while (!((bit >> n) & 1)) {
+			n++;
+		}
+#endif
+		if (index->bits[n]) {
+			rz_strbuf_appendf(sb, "%s%s", rz_strbuf_length(sb) ? " | " : "", index->bits[n]);
+		} else {
+			rest |= bit;
+		}
+	}
+	if (rest || !value) {
+		rz_strbuf_appendf(sb, "%s0x%" PFMT64x, rz_strbuf_length(sb) ? " | " : "", rest);
+	}
+	return rz_strbuf_drain(sb);
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_str.h>
+#include <rz_util/rz_strbuf.h>
+#include <rz_util/rz_assert.h>
+#include <rz_util/ht_pu.h>
+
+#include <types_parser.h>
+
+static const char *callconv_names[] = {
+	[C_CALLCONV_DEFAULT] = NULL,
+	[C_CALLCONV_CDECL] = "__cdecl",
+	[C_CALLCONV_STDCALL] = "__stdcall",
+	[C_CALLCONV_FASTCALL] = "__fastcall",
+	[C_CALLCONV_THISCALL] = "__thiscall",
+	[C_CALLCONV_VECTORCALL] = "__vectorcall",
+	[C_CALLCONV_MS_ABI] = "__attribute__((ms_abi))",
+	[C_CALLCONV_SYSV_ABI] = "__attribute__((sysv_abi))",
+};
+
+// Returns the stable id of the string, 0 for NULL or on failure.
+// Type ids of the signatures are the ids of the type strings
+ut32 c_parser_intern(CParserState *state, const char *str) {
+	rz_return_val_if_fail(state, 0);
+	return c_interner_intern(state->interner, state->intern_cache, str);
+}
+
+const char *c_parser_atom(CParserState *state, ut32 id) {
+	rz_return_val_if_fail(state, NULL);
+	return c_interner_string(state->interner, id);
+}
+
+// Renders "ret name(params)", or "ret (params)" without the name
+static char *signature_render(CParserState *state, const CFunction *fn, const ut32 *types, bool with_name) {
+	RzStrBuf *sb = rz_strbuf_new("");
+	if (!sb) {
+		return NULL;
+	}
+	const char *ret = c_parser_atom(state, fn->ret);
+	ret = ret ? ret : "int";
+	rz_strbuf_append(sb, ret);
+	bool pointer = *ret && ret[strlen(ret) - 1] == '*';
+	if (!pointer) {
+		rz_strbuf_append(sb, " ");
+	}
+	if (fn->callconv < RZ_ARRAY_SIZE(callconv_names) && callconv_names[fn->callconv]) {
+		rz_strbuf_appendf(sb, "%s ", callconv_names[fn->callconv]);
+	}
+	if (with_name && fn->name) {
+		rz_strbuf_append(sb, c_parser_atom(state, fn->name));
+	}
+	rz_strbuf_append(sb, "(");
+	ut32 i;
+	for (i = 0; i < fn->params_count; i++) {
+		const char *type = c_parser_atom(state, types[i]);
+		rz_strbuf_appendf(sb, "%s%s", i ? ", " : "", type ? type : "?");
+	}
+	if (fn->variadic) {
+		rz_strbuf_append(sb, fn->params_count ? ", ..." : "...");
+	} else if (!fn->params_count) {
+		rz_strbuf_append(sb, "void");
+	}
+	rz_strbuf_append(sb, ")");
+	return rz_strbuf_drain(sb);
+}
+
+const CFunction *c_parser_function(CParserState *state, ut32 id) {
+	rz_return_val_if_fail(state, NULL);
+	if (!id || id >= rz_vector_len(&state->functions)) {
+		return NULL;
+	}
+	return rz_vector_index_ptr(&state->functions, id);
+}
+
+// Looks up the prototype by the function name
+const CFunction *c_parser_find_function(CParserState *state, const char *name) {
+	rz_return_val_if_fail(state && name, NULL);
+	bool found = false;
+	ut32 id = ht_pu_find(state->functions_index, name, &found);
+	const CFunction *fn = found ? c_parser_function(state, id) : NULL;
+	return fn && fn->name ? fn : NULL;
+}
+
+char *c_parser_function_string(CParserState *state, const CFunction *fn) {
+	rz_return_val_if_fail(state && fn, NULL);
+	return signature_render(state, fn, rz_vector_index_ptr(&state->param_types, fn->params), true);
+}
+
+// Appends the signature to the table, the parameters are copied into the
+// shared arrays. Prototypes are merged by name and the function pointer
+// types by signature, so the repeated declarations don't grow the table.
+// Returns the function id, 0 on failure
+ut32 c_parser_store_function(CParserState *state, CFunction *fn, RzVector /*<ut32>*/ *types, RzVector /*<ut32>*/ *names) {
+	rz_return_val_if_fail(state && fn && types && names, 0);
+	fn->params_count = rz_vector_len(types);
+	char *signature = signature_render(state, fn, rz_vector_head(types), false);
+	fn->type = c_parser_intern(state, signature);
+	free(signature);
+	if (!fn->type) {
+		return 0;
+	}
+	const char *key = c_parser_atom(state, fn->name ? fn->name : fn->type);
+	bool found = false;
+	ut32 id = ht_pu_find(state->functions_index, key, &found);
+	if (found) {
+		const CFunction *stored = c_parser_function(state, id);
+		if (stored && fn->name && stored->type != fn->type) {
+			// The first prototype wins, like for the types
+			state->functions_conflicts++;
+			if (state->verbose) {
+				eprintf("Conflicting prototypes of %s\n", key);
+			}
+		} else if (fn->name) {
+			state->functions_merged++;
+		}
+		return id;
+	}
+	fn->params = rz_vector_len(&state->param_types);
+	if (fn->params_count) {
+		// Both arrays are grown first, so they cannot get out of sync
+		if (!rz_vector_reserve(&state->param_types, fn->params + fn->params_count)
+			|| !rz_vector_reserve(&state->param_names, fn->params + fn->params_count)) {
+			return 0;
+		}
+		rz_vector_insert_range(&state->param_types, fn->params, rz_vector_head(types), fn->params_count);
+		rz_vector_insert_range(&state->param_names, fn->params, rz_vector_head(names), fn->params_count);
+	}
+	id = rz_vector_len(&state->functions);
+	if (!rz_vector_push(&state->functions, fn)) {
+		return 0;
+	}
+	ht_pu_insert(state->functions_index, key, id);
+	return id;
+}
+
+// Copies the signatures of another state, e.g. of a parallel worker. The
+// strings are interned again, which only finds the same ids when the
+// interner is shared. Returns the new ids by the ids in the source state,
+// to translate the references, NULL on failure
+ut32 *c_parser_merge_functions(CParserState *state, CParserState *src) {
+	rz_return_val_if_fail(state && src, NULL);
+	ut32 count = rz_vector_len(&src->functions);
+	ut32 *ids = RZ_NEWS0(ut32, count);
+	if (!ids) {
+		return NULL;
+	}
+	RzVector types, names;
+	rz_vector_init(&types, sizeof(ut32), NULL, NULL);
+	rz_vector_init(&names, sizeof(ut32), NULL, NULL);
+	ut32 id;
+	for (id = 1; id < count; id++) {
+		const CFunction *fn = c_parser_function(src, id);
+		CFunction copy = {
+			.name = c_parser_intern(state, c_parser_atom(src, fn->name)),
+			.ret = c_parser_intern(state, c_parser_atom(src, fn->ret)),
+			.variadic = fn->variadic,
+			.callconv = fn->callconv,
+		};
+		rz_vector_clear(&types);
+		rz_vector_clear(&names);
+		ut32 i;
+		for (i = 0; i < fn->params_count; i++) {
+			ut32 *type = rz_vector_index_ptr(&src->param_types, fn->params + i);
+			ut32 *name = rz_vector_index_ptr(&src->param_names, fn->params + i);
+			ut32 atom = c_parser_intern(state, c_parser_atom(src, *type));
+			rz_vector_push(&types, &atom);
+			atom = c_parser_intern(state, c_parser_atom(src, *name));
+			rz_vector_push(&names, &atom);
+		}
+		ids[id] = c_parser_store_function(state, &copy, &types, &names);
+	}
+	rz_vector_fini(&types);
+	rz_vector_fini(&names);
+	return ids;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_assert.h>
+#include <rz_util/ht_pu.h>
+
+#include <types_parser.h>
+
+// Adds the global to the symbol index. Repeated declarations, like
+// "extern int a;" followed by "int a = 1;", are merged into the first
+// one, which only becomes defined. Declarations of a different type
+// are reported as the conflicts, and the first type wins
+bool c_parser_store_global(CParserState *state, CGlobal *global) {
+	rz_return_val_if_fail(state && global && global->name, false);
+	const char *name = c_parser_atom(state, global->name);
+	bool found = false;
+	ut32 index = ht_pu_find(state->globals_index, name, &found);
+	if (found) {
+		CGlobal *stored = rz_vector_index_ptr(&state->globals, index);
+		if (stored->type != global->type) {
+			state->globals_conflicts++;
+			if (state->verbose) {
+				eprintf("Conflicting declarations of %s\n", name);
+			}
+			return true;
+		}
+		stored->defined |= global->defined;
+		if (global->defined) {
+			stored->storage = global->storage;
+		}
+		return true;
+	}
+	index = rz_vector_len(&state->globals);
+	if (!rz_vector_push(&state->globals, global)) {
+		return false;
+	}
+	// Names are owned by the interned strings
+	ht_pu_insert(state->globals_index, name, index);
+	return true;
+}
+
+const CGlobal *c_parser_find_global(CParserState *state, const char *name) {
+	rz_return_val_if_fail(state && name, NULL);
+	bool found = false;
+	ut32 index = ht_pu_find(state->globals_index, name, &found);
+	return found ? rz_vector_index_ptr(&state->globals, index) : NULL;
+}
+
+// Copies the globals of another state, e.g. of a parallel worker, the
+// function pointer signatures are translated by the ids returned by
+// c_parser_merge_functions()
+bool c_parser_merge_globals(CParserState *state, CParserState *src, const ut32 *functions) {
+	rz_return_val_if_fail(state && src, false);
+	CGlobal *global;
+	rz_vector_foreach(&src->globals, global) {
+		CGlobal copy = *global;
+		copy.name = c_parser_intern(state, c_parser_atom(src, global->name));
+		copy.type = c_parser_intern(state, c_parser_atom(src, global->type));
+		copy.base = c_parser_intern(state, c_parser_atom(src, global->base));
+		copy.function = functions && global->function ? functions[global->function] : 0;
+		if (!copy.name || !c_parser_store_global(state, &copy)) {
+			return false;
+		}
+	}
+	return true;
+}
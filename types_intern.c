@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include <rz_types.h>
+#include <rz_th.h>
+#include <rz_util/rz_assert.h>
+
+#include <types_intern.h>
+
+#define INTERN_TABLE_MIN 256
+#define INTERN_PAGE_SIZE (1 << C_INTERN_PAGE_BITS)
+
+// Slots hold the low 32 bits of the hash and the id, 0 if empty.
+// Tables are grown at half load, so the probing always ends
+typedef struct intern_table_t {
+	ut32 mask;
+	ut32 count;
+	struct intern_table_t *prev; // Replaced tables, readers may still probe them
+	_Atomic(ut64) slots[];
+} InternTable;
+
+typedef struct intern_chunk_t {
+	struct intern_chunk_t *next;
+	char data[];
+} InternChunk;
+
+typedef struct {
+	RzThreadLock *lock; // Serializes the insertions
+	_Atomic(InternTable *) table;
+	InternChunk *chunks;
+	char *bump; // Free part of the current chunk
+	size_t left;
+	ut64 bytes;
+} InternShard;
+
+struct c_interner_t {
+	InternShard shards[C_INTERN_SHARDS];
+	_Atomic(ut32) next_id;
+	_Atomic(ut64) inserts_locked;
+	_Atomic(const char **) pages[C_INTERN_PAGES]; // Strings by id
+};
+
+// FNV-1a with a final mix, the top bits pick the shard
+// and the low ones the slot
+static ut64 intern_hash(const char *str) {
+	ut64 hash = 0xcbf29ce484222325ULL;
+	const ut8 *p;
+	for (p = (const ut8 *)str; *p; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static InternTable *table_new(ut32 size, InternTable *prev) {
+	InternTable *table = calloc(1, sizeof(InternTable) + size * sizeof(ut64));
+	if (!table) {
+		return NULL;
+	}
+	table->mask = size - 1;
+	table->prev = prev;
+	return table;
+}
+
+CInterner *c_interner_new(void) {
+	CInterner *interner = RZ_NEW0(CInterner);
+	if (!interner) {
+		return NULL;
+	}
+	atomic_init(&interner->next_id, 1);
+	int i;
+	for (i = 0; i < C_INTERN_SHARDS; i++) {
+		InternShard *shard = &interner->shards[i];
+		shard->lock = rz_th_lock_new(false);
+		InternTable *table = table_new(INTERN_TABLE_MIN, NULL);
+		atomic_init(&shard->table, table);
+		if (!shard->lock || !table) {
+			c_interner_free(interner);
+			return NULL;
+		}
+	}
+	return interner;
+}
+
+void c_interner_free(CInterner *interner) {
+	if (!interner) {
+		return;
+	}
+	int i;
+	for (i = 0; i < C_INTERN_SHARDS; i++) {
+		InternShard *shard = &interner->shards[i];
+		InternTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+		while (table) {
+			InternTable *prev = table->prev;
+			free(table);
+			table = prev;
+		}
+		InternChunk *chunk = shard->chunks;
+		while (chunk) {
+			InternChunk *next = chunk->next;
+			free(chunk);
+			chunk = next;
+		}
+		rz_th_lock_free(shard->lock);
+	}
+	for (i = 0; i < C_INTERN_PAGES; i++) {
+		free((void *)atomic_load_explicit(&interner->pages[i], memory_order_relaxed));
+	}
+	free(interner);
+}
+
+// Ids are only handed out once the string is stored, so any id
+// a thread got hold of refers to a complete entry
+const char *c_interner_string(CInterner *interner, ut32 id) {
+	rz_return_val_if_fail(interner, NULL);
+	if (!id || id >= atomic_load_explicit(&interner->next_id, memory_order_relaxed)) {
+		return NULL;
+	}
+	const char **page = atomic_load_explicit(&interner->pages[id >> C_INTERN_PAGE_BITS], memory_order_acquire);
+	return page ? page[id & (INTERN_PAGE_SIZE - 1)] : NULL;
+}
+
+static ut32 table_find(CInterner *interner, InternTable *table, ut64 hash, const char *str) {
+	ut32 tag = (ut32)hash;
+	ut32 i = tag & table->mask;
+	for (;; i = (i + 1) & table->mask) {
+		ut64 slot = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+		if (!slot) {
+			return 0;
+		}
+		ut32 id = (ut32)slot;
+		if ((ut32)(slot >> 32) == tag && !strcmp(c_interner_string(interner, id), str)) {
+			return id;
+		}
+	}
+}
+
+static void table_put(InternTable *table, ut64 slot) {
+	ut32 i = (ut32)(slot >> 32) & table->mask;
+	while (atomic_load_explicit(&table->slots[i], memory_order_relaxed)) {
+		i = (i + 1) & table->mask;
+	}
+	atomic_store_explicit(&table->slots[i], slot, memory_order_release);
+	table->count++;
+}
+
+// The old table is kept for the readers still probing it, all the
+// replaced tables together are smaller than the current one
+static InternTable *shard_grow(InternShard *shard, InternTable *old) {
+	InternTable *table = table_new((old->mask + 1) * 2, old);
+	if (!table) {
+		return NULL;
+	}
+	ut32 i;
+	for (i = 0; i <= old->mask; i++) {
+		ut64 slot = atomic_load_explicit(&old->slots[i], memory_order_relaxed);
+		if (slot) {
+			table_put(table, slot);
+		}
+	}
+	atomic_store_explicit(&shard->table, table, memory_order_release);
+	return table;
+}
+
+static char *shard_alloc(InternShard *shard, size_t size) {
+	if (size > C_INTERN_CHUNK / 4) {
+		// Large strings get their own chunk, the current one stays
+		InternChunk *chunk = malloc(sizeof(InternChunk) + size);
+		if (!chunk) {
+			return NULL;
+		}
+		chunk->next = shard->chunks;
+		shard->chunks = chunk;
+		shard->bytes += size;
+		return chunk->data;
+	}
+	if (size > shard->left) {
+		InternChunk *chunk = malloc(sizeof(InternChunk) + C_INTERN_CHUNK);
+		if (!chunk) {
+			return NULL;
+		}
+		chunk->next = shard->chunks;
+		shard->chunks = chunk;
+		shard->bump = chunk->data;
+		shard->left = C_INTERN_CHUNK;
+		shard->bytes += C_INTERN_CHUNK;
+	}
+	char *data = shard->bump;
+	shard->bump += size;
+	shard->left -= size;
+	return data;
+}
+
+// Stores the string in the directory under a new id
+static ut32 interner_add(CInterner *interner, const char *str) {
+	ut32 id = atomic_fetch_add(&interner->next_id, 1);
+	ut32 index = id >> C_INTERN_PAGE_BITS;
+	if (index >= C_INTERN_PAGES) {
+		return 0;
+	}
+	const char **page = atomic_load_explicit(&interner->pages[index], memory_order_acquire);
+	if (!page) {
+		// Shards share the pages, the first allocation wins
+		const char **fresh = RZ_NEWS0(const char *, INTERN_PAGE_SIZE);
+		if (!fresh) {
+			return 0;
+		}
+		if (atomic_compare_exchange_strong(&interner->pages[index], &page, fresh)) {
+			page = fresh;
+		} else {
+			free(fresh);
+		}
+	}
+	page[id & (INTERN_PAGE_SIZE - 1)] = str;
+	return id;
+}
+
+// Called with the shard lock held, another thread may have
+// inserted the string since the lock-free lookup
+static ut32 shard_insert(CInterner *interner, InternShard *shard, ut64 hash, const char *str) {
+	InternTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+	ut32 id = table_find(interner, table, hash, str);
+	if (id) {
+		return id;
+	}
+	if ((table->count + 1) * 2 > table->mask + 1) {
+		table = shard_grow(shard, table);
+		if (!table) {
+			return 0;
+		}
+	}
+	size_t size = strlen(str) + 1;
+	char *copy = shard_alloc(shard, size);
+	if (!copy) {
+		return 0;
+	}
+	memcpy(copy, str, size);
+	id = interner_add(interner, copy);
+	if (id) {
+		table_put(table, ((ut64)(ut32)hash << 32) | id);
+	}
+	return id;
+}
+
+// Returns the stable id of the string, 0 for NULL or on failure. The
+// cache is optional, it must be used by a single thread only
+ut32 c_interner_intern(CInterner *interner, CInternCache *cache, const char *str) {
+	rz_return_val_if_fail(interner && (!cache || cache->interner == interner), 0);
+	if (!str) {
+		return 0;
+	}
+	ut64 hash = intern_hash(str);
+	CInternCacheEntry *cached = NULL;
+	if (cache) {
+		cached = &cache->entries[hash & ((1 << C_INTERN_CACHE_BITS) - 1)];
+		if (cached->id && cached->hash == hash && !strcmp(c_interner_string(interner, cached->id), str)) {
+			cache->hits++;
+			return cached->id;
+		}
+		cache->misses++;
+	}
+	InternShard *shard = &interner->shards[hash >> (64 - C_INTERN_SHARD_BITS)];
+	InternTable *table = atomic_load_explicit(&shard->table, memory_order_acquire);
+	ut32 id = table_find(interner, table, hash, str);
+	if (!id) {
+		rz_th_lock_enter(shard->lock);
+		id = shard_insert(interner, shard, hash, str);
+		rz_th_lock_leave(shard->lock);
+		atomic_fetch_add_explicit(&interner->inserts_locked, 1, memory_order_relaxed);
+	}
+	if (cached && id) {
+		cached->hash = hash;
+		cached->id = id;
+	}
+	return id;
+}
+
+// Only consistent while no thread interns
+void c_interner_stats(CInterner *interner, CInternStats *stats) {
+	rz_return_if_fail(interner && stats);
+	stats->strings = atomic_load(&interner->next_id) - 1;
+	stats->inserts_locked = atomic_load(&interner->inserts_locked);
+	stats->bytes = 0;
+	int i;
+	for (i = 0; i < C_INTERN_SHARDS; i++) {
+		stats->bytes += interner->shards[i].bytes;
+	}
+}
+
+CInternCache *c_intern_cache_new(CInterner *interner) {
+	rz_return_val_if_fail(interner, NULL);
+	CInternCache *cache = RZ_NEW0(CInternCache);
+	if (cache) {
+		cache->interner = interner;
+	}
+	return cache;
+}
+
+void c_intern_cache_free(CInternCache *cache) {
+	free(cache);
+}
@@ -0,0 +1,50 @@
+#ifndef TYPES_INTERN_H
+#define TYPES_INTERN_H
+
+#include <rz_types.h>
+
+// String interner shared by the threads. The ids are dense, 0 stands for
+// NULL, and the same for every thread. The strings are copied into the
+// arena chunks of the shard, so they never move and stay valid until the
+// interner is freed. The lookups take no locks: a thread checks its own
+// cache first, then probes the shard table, and only the insertion of
+// a new string takes the shard lock.
+
+#define C_INTERN_SHARD_BITS 5
+#define C_INTERN_SHARDS (1 << C_INTERN_SHARD_BITS)
+#define C_INTERN_PAGE_BITS 12 // Ids per page of the id to string directory
+#define C_INTERN_PAGES (1 << 14)
+#define C_INTERN_CACHE_BITS 12 // Entries of the thread local caches
+#define C_INTERN_CHUNK 0x10000 // Arena chunk size
+
+typedef struct c_interner_t CInterner;
+
+typedef struct {
+	ut64 hash;
+	ut32 id;
+} CInternCacheEntry;
+
+// Direct mapped cache of a single thread
+typedef struct {
+	CInterner *interner;
+	ut64 hits;
+	ut64 misses;
+	CInternCacheEntry entries[1 << C_INTERN_CACHE_BITS];
+} CInternCache;
+
+typedef struct {
+	ut32 strings;
+	ut64 bytes; // Arena bytes allocated
+	ut64 inserts_locked; // Lookups which took the shard lock
+} CInternStats;
+
+CInterner *c_interner_new(void);
+void c_interner_free(CInterner *interner);
+ut32 c_interner_intern(CInterner *interner, CInternCache *cache, const char *str);
+const char *c_interner_string(CInterner *interner, ut32 id);
+void c_interner_stats(CInterner *interner, CInternStats *stats);
+
+CInternCache *c_intern_cache_new(CInterner *interner);
+void c_intern_cache_free(CInternCache *cache);
+
+#endif
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_list.h>
+#include <rz_util/rz_str.h>
+#include <rz_util/rz_strbuf.h>
+#include <rz_util/rz_assert.h>
+#include <rz_type.h>
+#include <tree_sitter/api.h>
+
+#include <types_parser.h>
+
+typedef struct {
+	const char *name;
+	ut32 size;
+} CAtomicType;
+
+// Sizes of the long and the pointer sized types
+#define ATOMIC_POINTER_SIZE 0
+
+// Alignment of every atomic type matches its size. The long and the
+// pointer sized types follow the target pointer size, which covers the
+// ILP32 and LP64 data models, but not LLP64, where long stays 4 bytes
+static const CAtomicType atomic_types[] = {
+	{ "char", 1 },
+	{ "signed char", 1 },
+	{ "unsigned char", 1 },
+	{ "_Bool", 1 },
+	{ "bool", 1 },
+	{ "short", 2 },
+	{ "short int", 2 },
+	{ "signed short", 2 },
+	{ "unsigned short", 2 },
+	{ "unsigned short int", 2 },
+	{ "int", 4 },
+	{ "signed", 4 },
+	{ "signed int", 4 },
+	{ "unsigned", 4 },
+	{ "unsigned int", 4 },
+	{ "long", ATOMIC_POINTER_SIZE },
+	{ "long int", ATOMIC_POINTER_SIZE },
+	{ "signed long", ATOMIC_POINTER_SIZE },
+	{ "unsigned long", ATOMIC_POINTER_SIZE },
+	{ "unsigned long int", ATOMIC_POINTER_SIZE },
+	{ "long long", 8 },
+	{ "long long int", 8 },
+	{ "signed long long", 8 },
+	{ "unsigned long long", 8 },
+	{ "unsigned long long int", 8 },
+	{ "float", 4 },
+	{ "double", 8 },
+	{ "long double", 16 },
+	{ "int8_t", 1 },
+	{ "uint8_t", 1 },
+	{ "int16_t", 2 },
+	{ "uint16_t", 2 },
+	{ "int32_t", 4 },
+	{ "uint32_t", 4 },
+	{ "int64_t", 8 },
+	{ "uint64_t", 8 },
+	{ "size_t", ATOMIC_POINTER_SIZE },
+	{ "ssize_t", ATOMIC_POINTER_SIZE },
+	{ "ptrdiff_t", ATOMIC_POINTER_SIZE },
+	{ "intptr_t", ATOMIC_POINTER_SIZE },
+	{ "uintptr_t", ATOMIC_POINTER_SIZE },
+	{ "wchar_t", 4 },
+};
+
+static ut32 atomic_type_size(CParserState *state, const char *name) {
+	size_t i;
+	for (i = 0; i < RZ_ARRAY_SIZE(atomic_types); i++) {
+		if (!strcmp(atomic_types[i].name, name)) {
+			ut32 size = atomic_types[i].size;
+			return size == ATOMIC_POINTER_SIZE ? state->pointer_size : size;
+		}
+	}
+	return 0;
+}
+
+static ut32 align_up(ut32 offset, ut32 align) {
+	return align > 1 ? (offset + align - 1) / align * align : offset;
+}
+
+// Returns the stored type the member embeds by value. Pointers don't
+// need the layout of the pointed type, thus such references stay lazy
+static CType *member_dependency(CParserState *state, CTypeMember *member) {
+	if (member->pointers || !member->type) {
+		return NULL;
+	}
+	return c_parser_find_type(state, member->type);
+}
+
+static bool member_layout(CParserState *state, CTypeMember *member, ut32 *size, ut32 *align) {
+	ut32 elem_size, elem_align;
+	if (member->pointers) {
+		elem_size = elem_align = state->pointer_size;
+	} else if (member->function) {
+		// Function types have no size, e.g. "typedef int fn_t(int);",
+		// only the pointers to them are laid out
+		elem_size = 0;
+		elem_align = 1;
+	} else {
+		CType *dep = member->type ? c_parser_find_type(state, member->type) : NULL;
+		if (dep) {
+			if (!dep->laid_out) {
+				return false;
+			}
+			elem_size = dep->size;
+			elem_align = dep->align;
+		} else {
+			elem_size = member->type ? atomic_type_size(state, member->type) : 0;
+			if (!elem_size) {
+				return false;
+			}
+			elem_align = elem_size;
+		}
+	}
+	*size = member->array ? elem_size * member->array : elem_size;
+	*align = elem_align ? elem_align : 1;
+	return true;
+}
+
+// Bitfields are packed as in the SysV ABI: a bitfield takes the next free
+// bit, unless it would cross a boundary of its declared type, so e.g.
+// "char a:3; int b:5;" share a single int. The offset of a bitfield is
+// the one of the storage unit of its type holding it
+static bool layout_struct(CParserState *state, CType *type) {
+	ut64 bit = 0; // End of the last member
+	ut32 max_align = 1;
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		ut32 size, align;
+		if (!member_layout(state, member, &size, &align)) {
+			return false;
+		}
+		if (member->bits && size) {
+			ut64 unit_bits = (ut64)size * 8;
+			if (bit / unit_bits != (bit + member->bits - 1) / unit_bits) {
+				bit = (bit + unit_bits - 1) / unit_bits * unit_bits;
+			}
+			member->offset = bit / unit_bits * size;
+			member->bit_offset = bit - (ut64)member->offset * 8;
+			bit += member->bits;
+		} else {
+			ut32 offset = align_up((bit + 7) / 8, align);
+			member->offset = offset;
+			member->bit_offset = 0;
+			bit = ((ut64)offset + size) * 8;
+		}
+		max_align = RZ_MAX(max_align, align);
+	}
+	type->size = align_up((bit + 7) / 8, max_align);
+	type->align = max_align;
+	return true;
+}
+
+static bool layout_union(CParserState *state, CType *type) {
+	ut32 max_size = 0;
+	ut32 max_align = 1;
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		ut32 size, align;
+		if (!member_layout(state, member, &size, &align)) {
+			return false;
+		}
+		member->offset = 0;
+		member->bit_offset = 0;
+		max_size = RZ_MAX(max_size, size);
+		max_align = RZ_MAX(max_align, align);
+	}
+	type->size = align_up(max_size, max_align);
+	type->align = max_align;
+	return true;
+}
+
+// Returns the struct or union the member embeds by value, if any
+static CType *member_aggregate(CParserState *state, CTypeMember *member) {
+	if (member->pointers || !member->type) {
+		return NULL;
+	}
+	CType *type = c_parser_find_type(state, c_parser_canonical_type(state, member->type));
+	if (!type || (type->kind != C_TYPE_KIND_STRUCT && type->kind != C_TYPE_KIND_UNION)) {
+		return NULL;
+	}
+	return type;
+}
+
+static bool flatten_members(CParserState *state, CType *root, CType *type, ut32 base, const char *prefix) {
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		ut32 size, align;
+		if (!member_layout(state, member, &size, &align)) {
+			return false;
+		}
+		// Members of the anonymous nested struct or union
+		// are accessed as the members of the enclosing one
+		char *path = member->name
+			? rz_str_newf("%s%s", prefix, member->name)
+			: strdup(prefix);
+		if (!path) {
+			return false;
+		}
+		CType *aggregate = member_aggregate(state, member);
+		if (aggregate && !member->array) {
+			char *nested_prefix = member->name ? rz_str_newf("%s.", path) : strdup(path);
+			free(path);
+			if (!nested_prefix) {
+				return false;
+			}
+			bool ok = flatten_members(state, root, aggregate, base + member->offset, nested_prefix);
+			free(nested_prefix);
+			if (!ok) {
+				return false;
+			}
+			continue;
+		}
+		CTypeOffset entry = {
+			.offset = base + member->offset,
+			.size = member->array ? size / member->array : size,
+			.count = member->array ? member->array : 1,
+			.order = rz_vector_len(&root->offsets),
+			.bit_offset = member->bit_offset,
+			.bits = member->bits,
+			.path = path,
+			.elem = aggregate,
+		};
+		rz_vector_push(&root->offsets, &entry);
+	}
+	return true;
+}
+
+static int type_offset_cmp(const void *a, const void *b) {
+	const CTypeOffset *ea = a;
+	const CTypeOffset *eb = b;
+	if (ea->offset != eb->offset) {
+		return ea->offset < eb->offset ? -1 : 1;
+	}
+	return ea->order < eb->order ? -1 : ea->order > eb->order;
+}
+
+// Builds the flattened member table of the struct or union. Nested
+// aggregates are inlined, while arrays of them keep a single entry
+// resolved by the stride at the query time, so the table stays small.
+static bool build_offsets(CParserState *state, CType *type) {
+	rz_vector_clear(&type->offsets);
+	if (!flatten_members(state, type, type, 0, "")) {
+		rz_vector_clear(&type->offsets);
+		return false;
+	}
+	CTypeOffset *entries = rz_vector_head(&type->offsets);
+	ut32 count = rz_vector_len(&type->offsets);
+	qsort(entries, count, sizeof(CTypeOffset), type_offset_cmp);
+	ut32 i, end_max = 0;
+	for (i = 0; i < count; i++) {
+		end_max = RZ_MAX(end_max, entries[i].offset + entries[i].size * entries[i].count);
+		entries[i].end_max = end_max;
+	}
+	return true;
+}
+
+// Returns the first declared entry covering the offset, NULL if it's padding
+static CTypeOffset *find_offset(CType *type, ut32 offset) {
+	CTypeOffset *entries = rz_vector_head(&type->offsets);
+	ut32 count = rz_vector_len(&type->offsets);
+	// Number of entries starting at or before the offset
+	ut32 lo = 0, hi = count;
+	while (lo < hi) {
+		ut32 mid = lo + (hi - lo) / 2;
+		if (entries[mid].offset <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	// Only the overlapping union members make this scan longer than one step
+	CTypeOffset *found = NULL;
+	while (lo > 0 && entries[lo - 1].end_max > offset) {
+		CTypeOffset *entry = &entries[--lo];
+		if (offset < entry->offset + entry->size * entry->count
+				&& (!found || entry->order < found->order)) {
+			found = entry;
+		}
+	}
+	return found;
+}
+
+// Returns the path of the member at the byte offset, e.g. "y.a" or
+// "arr[3].x", or NULL if the offset falls into padding or outside.
+// Every level is a binary search in the precomputed member table.
+char *c_parser_member_at(CParserState *state, CType *type, ut32 offset) {
+	rz_return_val_if_fail(state && type, NULL);
+	if (type->kind == C_TYPE_KIND_TYPEDEF) {
+		type = c_parser_find_type(state, c_parser_canonical_type(state, type->name));
+	}
+	if (!type || !type->laid_out || offset >= type->size) {
+		return NULL;
+	}
+	RzStrBuf *sb = rz_strbuf_new("");
+	if (!sb) {
+		return NULL;
+	}
+	for (;;) {
+		CTypeOffset *entry = find_offset(type, offset);
+		if (!entry) {
+			rz_strbuf_free(sb);
+			return NULL;
+		}
+		rz_strbuf_append(sb, entry->path);
+		ut32 rel = offset - entry->offset;
+		if (entry->count > 1 || entry->elem) {
+			rz_strbuf_appendf(sb, "[%u]", entry->size ? rel / entry->size : 0);
+		}
+		if (!entry->elem || !entry->size) {
+			break;
+		}
+		rz_strbuf_append(sb, ".");
+		offset = rel % entry->size;
+		type = entry->elem;
+	}
+	return rz_strbuf_drain(sb);
+}
+
+// All the by-value dependencies should be laid out before
+static bool layout_type(CParserState *state, CType *type) {
+	if (type->forward || type->templated) {
+		return false;
+	}
+	switch (type->kind) {
+	case C_TYPE_KIND_STRUCT:
+		return layout_struct(state, type) && build_offsets(state, type);
+	case C_TYPE_KIND_UNION:
+		return layout_union(state, type) && build_offsets(state, type);
+	case C_TYPE_KIND_ENUM:
+		type->size = 4;
+		type->align = 4;
+		return true;
+	case C_TYPE_KIND_TYPEDEF:
+		if (rz_vector_len(&type->members) != 1) {
+			return false;
+		}
+		return member_layout(state, rz_vector_index_ptr(&type->members, 0), &type->size, &type->align);
+	}
+	return false;
+}
+
+static bool collect_type(void *user, const void *k, const void *v) {
+	rz_pvector_push(user, (void *)v);
+	return true;
+}
+
+// Lays out the types in a single pass. Every type is laid out after the
+// types it embeds by value, following the Kahn's topological order of
+// the dependency graph. Only the edges between the given types count,
+// the other types keep their layouts. Types left with unresolved
+// dependencies after the pass are the parts of by-value cycles, or
+// depend on them. Returns the number of types that could not be laid out
+// because of the cycles or by-value use of the incomplete types.
+static int layout_types(CParserState *state, RzPVector /*<CType *>*/ *types) {
+	ut32 count = rz_pvector_len(types);
+	ut32 epoch = ++state->layout_epoch;
+	// Number of not yet laid out by-value dependencies of every type, and
+	// the edges from every dependency to its dependent types in CSR form
+	ut32 *indegree = RZ_NEWS0(ut32, count + 1);
+	ut32 *edge_start = RZ_NEWS0(ut32, count + 2);
+	ut32 *queue = RZ_NEWS0(ut32, count + 1);
+	ut32 *edges = NULL;
+	int failed = -1;
+	if (!indegree || !edge_start || !queue) {
+		goto beach;
+	}
+	ut32 i;
+	for (i = 0; i < count; i++) {
+		CType *type = rz_pvector_at(types, i);
+		type->index = i;
+		type->layout_epoch = epoch;
+		type->laid_out = false;
+		type->invalid = false;
+	}
+	CTypeMember *member;
+	for (i = 0; i < count; i++) {
+		CType *type = rz_pvector_at(types, i);
+		rz_vector_foreach(&type->members, member) {
+			CType *dep = member_dependency(state, member);
+			if (dep && dep->layout_epoch == epoch) {
+				edge_start[dep->index + 2]++;
+				indegree[i]++;
+			}
+		}
+	}
+	for (i = 2; i < count + 2; i++) {
+		edge_start[i] += edge_start[i - 1];
+	}
+	edges = RZ_NEWS0(ut32, edge_start[count + 1] + 1);
+	if (!edges) {
+		goto beach;
+	}
+	// edge_start[dep + 1] is used as a cursor, and ends up
+	// pointing to the start of the next dependency edges
+	for (i = 0; i < count; i++) {
+		CType *type = rz_pvector_at(types, i);
+		rz_vector_foreach(&type->members, member) {
+			CType *dep = member_dependency(state, member);
+			if (dep && dep->layout_epoch == epoch) {
+				edges[edge_start[dep->index + 1]++] = i;
+			}
+		}
+	}
+	ut32 head = 0, tail = 0;
+	for (i = 0; i < count; i++) {
+		if (!indegree[i]) {
+			queue[tail++] = i;
+		}
+	}
+	failed = 0;
+	while (head < tail) {
+		ut32 cur = queue[head++];
+		CType *type = rz_pvector_at(types, cur);
+		type->laid_out = layout_type(state, type);
+		if (!type->laid_out && (type->forward || type->templated)) {
+			// Fine unless some other type embeds it by value
+		} else if (!type->laid_out) {
+			eprintf("ERROR: Cannot compute the layout of %s, it embeds an incomplete type\n", type->name);
+			failed++;
+		} else if (state->verbose) {
+			printf("layout: %s size: %u align: %u\n", type->name, type->size, type->align);
+		}
+		ut32 e;
+		for (e = edge_start[cur]; e < edge_start[cur + 1]; e++) {
+			if (!--indegree[edges[e]]) {
+				queue[tail++] = edges[e];
+			}
+		}
+	}
+	for (i = 0; i < count; i++) {
+		if (indegree[i]) {
+			CType *type = rz_pvector_at(types, i);
+			eprintf("ERROR: Cannot compute the layout of %s, it is a part of or depends on a by-value cycle\n", type->name);
+			failed++;
+		}
+	}
+beach:
+	free(indegree);
+	free(edge_start);
+	free(queue);
+	free(edges);
+	return failed;
+}
+
+// Computes the layouts of all the stored types
+int c_parser_compute_layouts(CParserState *state) {
+	rz_return_val_if_fail(state, -1);
+	RzPVector types;
+	rz_pvector_init(&types, NULL);
+	ht_pp_foreach(state->types, collect_type, &types);
+	int failed = layout_types(state, &types);
+	rz_pvector_fini(&types);
+	rz_pvector_clear(&state->invalid);
+	state->layouts_computed = true;
+	return failed;
+}
+
+// Computes again only the layouts invalidated since the last pass, i.e. of
+// the types stored or redefined since then, and of the types embedding
+// them by value. The cost follows the number of these types, not of all
+// the stored ones. Returns the same as c_parser_compute_layouts()
+int c_parser_update_layouts(CParserState *state) {
+	rz_return_val_if_fail(state, -1);
+	if (!state->layouts_computed) {
+		return c_parser_compute_layouts(state);
+	}
+	int failed = layout_types(state, &state->invalid);
+	rz_pvector_clear(&state->invalid);
+	return failed;
+}
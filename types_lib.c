@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/rz_file.h>
+#include <rz_util/rz_assert.h>
+#include <rz_util/ht_pu.h>
+
+#include <types_lib.h>
+
+#if __UNIX__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Growable output buffer of the writer
+typedef struct {
+	ut8 *data;
+	size_t len;
+	size_t capacity;
+} LibBuf;
+
+static bool lib_buf_append(LibBuf *buf, const void *data, size_t len) {
+	if (buf->len + len > buf->capacity) {
+		size_t capacity = buf->capacity ? buf->capacity : 4096;
+		while (capacity < buf->len + len) {
+			capacity *= 2;
+		}
+		ut8 *tmp = realloc(buf->data, capacity);
+		if (!tmp) {
+			return false;
+		}
+		buf->data = tmp;
+		buf->capacity = capacity;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+	return true;
+}
+
+static bool lib_buf_align(LibBuf *buf, size_t align) {
+	static const ut8 zeros[8] = { 0 };
+	size_t pad = (align - buf->len % align) % align;
+	return lib_buf_append(buf, zeros, pad);
+}
+
+// FNV-1a, part of the format since the name index is stored
+static ut32 lib_hash(const char *s) {
+	ut32 hash = 0x811c9dc5;
+	for (; *s; s++) {
+		hash ^= (ut8)*s;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+typedef struct {
+	LibBuf buf;
+	HtPU *offsets; // Deduplicated strings
+} LibStrings;
+
+static ut32 lib_string(LibStrings *strings, const char *s) {
+	if (!s) {
+		return 0;
+	}
+	bool found = false;
+	ut64 offset = ht_pu_find(strings->offsets, s, &found);
+	if (found) {
+		return offset;
+	}
+	offset = strings->buf.len;
+	if (offset > UT32_MAX || !lib_buf_append(&strings->buf, s, strlen(s) + 1)) {
+		return C_TYPE_LIB_NONE;
+	}
+	ht_pu_insert(strings->offsets, s, offset);
+	return offset;
+}
+
+// Serializes all the stored types, with their layouts if computed
+int c_type_lib_save(CParserState *state, const char *path) {
+	rz_return_val_if_fail(state && path, -1);
+	int result = -1;
+	RzPVector *types = c_parser_complete_type(state, "");
+	if (!types) {
+		return -1;
+	}
+	ut32 types_count = rz_pvector_len(types);
+	ut32 buckets_count = 1;
+	while (buckets_count < types_count) {
+		buckets_count <<= 1;
+	}
+	CTypeLibType *records = RZ_NEWS0(CTypeLibType, types_count);
+	ut32 *buckets = RZ_NEWS(ut32, buckets_count);
+	char **keys = RZ_NEWS0(char *, types_count);
+	LibBuf members = { 0 };
+	LibStrings strings = { .offsets = ht_pu_new0() };
+	LibBuf out = { 0 };
+	if (!records || !buckets || !keys || !strings.offsets) {
+		goto beach;
+	}
+	memset(buckets, 0xff, buckets_count * sizeof(ut32));
+	// Offset 0 stands for the absent strings
+	if (!lib_buf_append(&strings.buf, "", 1)) {
+		goto beach;
+	}
+	ut32 i, members_count = 0;
+	for (i = 0; i < types_count; i++) {
+		CType *type = rz_pvector_at(types, i);
+		CTypeLibType *record = &records[i];
+		keys[i] = c_type_key(type->kind, type->name);
+		if (!keys[i]) {
+			goto beach;
+		}
+		record->hash = type->hash;
+		record->name = lib_string(&strings, type->name);
+		record->key = lib_string(&strings, keys[i]);
+		record->canonical = type->kind == C_TYPE_KIND_TYPEDEF
+			? lib_string(&strings, c_parser_canonical_type(state, keys[i]))
+			: record->key;
+		record->members = members_count;
+		record->members_count = rz_vector_len(&type->members);
+		record->size = type->size;
+		record->align = type->align;
+		record->kind = type->kind;
+		record->flags = (type->anonymous ? C_TYPE_LIB_ANONYMOUS : 0)
+			| (type->forward ? C_TYPE_LIB_FORWARD : 0)
+			| (type->laid_out ? C_TYPE_LIB_LAID_OUT : 0);
+		CTypeMember *member;
+		rz_vector_foreach(&type->members, member) {
+			// Function ids are local to the state, the signature is stored instead
+			const CFunction *fn = member->function ? c_parser_function(state, member->function) : NULL;
+			CTypeLibMember m = {
+				.name = lib_string(&strings, member->name),
+				.type = lib_string(&strings, member->type),
+				.value = lib_string(&strings, member->value),
+				.function = lib_string(&strings, fn ? c_parser_atom(state, fn->type) : NULL),
+				.pointers = member->pointers,
+				.array = member->array,
+				.bits = member->bits,
+				.offset = member->offset,
+				.bit_offset = member->bit_offset,
+			};
+			if (m.name == C_TYPE_LIB_NONE || m.type == C_TYPE_LIB_NONE || m.value == C_TYPE_LIB_NONE || m.function == C_TYPE_LIB_NONE
+				|| !lib_buf_append(&members, &m, sizeof(m))) {
+				goto beach;
+			}
+			members_count++;
+		}
+		if (record->name == C_TYPE_LIB_NONE || record->key == C_TYPE_LIB_NONE || record->canonical == C_TYPE_LIB_NONE) {
+			goto beach;
+		}
+		ut32 bucket = lib_hash(keys[i]) & (buckets_count - 1);
+		record->next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	CTypeLibHeader header = {
+		.magic = C_TYPE_LIB_MAGIC,
+		.version = C_TYPE_LIB_VERSION,
+		.byte_order = C_TYPE_LIB_BYTE_ORDER,
+		.pointer_size = state->pointer_size,
+		.types_count = types_count,
+		.members_count = members_count,
+		.buckets_count = buckets_count,
+		.strings_size = strings.buf.len,
+	};
+	// Header is rewritten once the section offsets are known
+	if (!lib_buf_append(&out, &header, sizeof(header)) || !lib_buf_align(&out, 8)) {
+		goto beach;
+	}
+	header.types_offset = out.len;
+	if (!lib_buf_append(&out, records, types_count * sizeof(CTypeLibType)) || !lib_buf_align(&out, 8)) {
+		goto beach;
+	}
+	header.members_offset = out.len;
+	if (!lib_buf_append(&out, members.data, members.len) || !lib_buf_align(&out, 8)) {
+		goto beach;
+	}
+	header.buckets_offset = out.len;
+	if (!lib_buf_append(&out, buckets, buckets_count * sizeof(ut32))) {
+		goto beach;
+	}
+	header.strings_offset = out.len;
+	if (!lib_buf_append(&out, strings.buf.data, strings.buf.len)) {
+		goto beach;
+	}
+	if (out.len > UT32_MAX) {
+		eprintf("Type library \"%s\" is too big\n", path);
+		goto beach;
+	}
+	header.file_size = out.len;
+	memcpy(out.data, &header, sizeof(header));
+	if (!rz_file_dump(path, out.data, out.len, false)) {
+		eprintf("Cannot write the type library \"%s\"\n", path);
+		goto beach;
+	}
+	result = 0;
+
+beach:
+	if (keys) {
+		for (i = 0; i < types_count; i++) {
+			free(keys[i]);
+		}
+	}
+	free(keys);
+	free(records);
+	free(buckets);
+	free(members.data);
+	free(strings.buf.data);
+	ht_pu_free(strings.offsets);
+	free(out.data);
+	rz_pvector_free(types);
+	return result;
+}
+
+static bool lib_section_valid(const CTypeLib *lib, ut32 offset, ut32 count, size_t elem_size, size_t align) {
+	return !(offset % align) && offset <= lib->size && count <= (lib->size - offset) / elem_size;
+}
+
+// Only the header and the section bounds are checked, the records are
+// validated on access, so opening takes the same time for any size
+static bool lib_init(CTypeLib *lib) {
+	if (lib->size < sizeof(CTypeLibHeader)) {
+		return false;
+	}
+	const CTypeLibHeader *header = (const CTypeLibHeader *)lib->data;
+	if (memcmp(header->magic, C_TYPE_LIB_MAGIC, sizeof(C_TYPE_LIB_MAGIC))
+		|| header->version != C_TYPE_LIB_VERSION
+		|| header->byte_order != C_TYPE_LIB_BYTE_ORDER
+		|| header->file_size != lib->size
+		|| !header->buckets_count || (header->buckets_count & (header->buckets_count - 1))
+		|| !header->strings_size
+		|| !lib_section_valid(lib, header->types_offset, header->types_count, sizeof(CTypeLibType), 8)
+		|| !lib_section_valid(lib, header->members_offset, header->members_count, sizeof(CTypeLibMember), 4)
+		|| !lib_section_valid(lib, header->buckets_offset, header->buckets_count, sizeof(ut32), 4)
+		|| !lib_section_valid(lib, header->strings_offset, header->strings_size, 1, 1)) {
+		return false;
+	}
+	lib->header = header;
+	lib->types = (const CTypeLibType *)(lib->data + header->types_offset);
+	lib->members = (const CTypeLibMember *)(lib->data + header->members_offset);
+	lib->buckets = (const ut32 *)(lib->data + header->buckets_offset);
+	lib->strings = (const char *)(lib->data + header->strings_offset);
+	// Every string is terminated then
+	return lib->strings[header->strings_size - 1] == '\0';
+}
+
+CTypeLib *c_type_lib_open(const char *path) {
+	rz_return_val_if_fail(path, NULL);
+	CTypeLib *lib = RZ_NEW0(CTypeLib);
+	if (!lib) {
+		return NULL;
+	}
+#if __UNIX__
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd != -1 && !fstat(fd, &st) && st.st_size > 0) {
+		void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			lib->data = data;
+			lib->size = st.st_size;
+			lib->mapped = true;
+		}
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+#endif
+	if (!lib->data) {
+		size_t size = 0;
+		lib->data = (const ut8 *)rz_file_slurp(path, &size);
+		lib->size = size;
+	}
+	if (!lib->data || !lib_init(lib)) {
+		eprintf("Invalid type library \"%s\"\n", path);
+		c_type_lib_close(lib);
+		return NULL;
+	}
+	return lib;
+}
+
+void c_type_lib_close(CTypeLib *lib) {
+	if (!lib) {
+		return;
+	}
+#if __UNIX__
+	if (lib->mapped) {
+		munmap((void *)lib->data, lib->size);
+		lib->data = NULL;
+	}
+#endif
+	free((void *)lib->data);
+	free(lib);
+}
+
+// Returns NULL for the absent strings and the invalid offsets
+const char *c_type_lib_string(const CTypeLib *lib, ut32 offset) {
+	rz_return_val_if_fail(lib, NULL);
+	if (!offset || offset >= lib->header->strings_size) {
+		return NULL;
+	}
+	return lib->strings + offset;
+}
+
+// Same as c_parser_find_type(), e.g. "struct S1" or "jint"
+const CTypeLibType *c_type_lib_find(const CTypeLib *lib, const char *name) {
+	rz_return_val_if_fail(lib && name, NULL);
+	ut32 index = lib->buckets[lib_hash(name) & (lib->header->buckets_count - 1)];
+	// Corrupted chains cannot loop forever
+	ut32 steps = 0;
+	while (index < lib->header->types_count && steps++ < lib->header->types_count) {
+		const CTypeLibType *type = &lib->types[index];
+		const char *key = c_type_lib_string(lib, type->key);
+		if (key && !strcmp(key, name)) {
+			return type;
+		}
+		index = type->next;
+	}
+	return NULL;
+}
+
+const CTypeLibMember *c_type_lib_member(const CTypeLib *lib, const CTypeLibType *type, ut32 i) {
+	rz_return_val_if_fail(lib && type, NULL);
+	if (i >= type->members_count) {
+		return NULL;
+	}
+	ut64 index = (ut64)type->members + i;
+	return index < lib->header->members_count ? &lib->members[index] : NULL;
+}
+
+// Same as c_parser_complete_type(), the types are stored sorted by name
+RzPVector /*<const CTypeLibType *>*/ *c_type_lib_complete(const CTypeLib *lib, const char *prefix) {
+	rz_return_val_if_fail(lib && prefix, NULL);
+	RzPVector *result = rz_pvector_new(NULL);
+	if (!result) {
+		return NULL;
+	}
+	size_t prefix_len = strlen(prefix);
+	ut32 count = lib->header->types_count;
+	ut32 lo = 0, hi = count;
+	while (lo < hi) {
+		ut32 mid = lo + (hi - lo) / 2;
+		const char *name = c_type_lib_string(lib, lib->types[mid].name);
+		if (strcmp(name ? name : "", prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for (; lo < count; lo++) {
+		const char *name = c_type_lib_string(lib, lib->types[lo].name);
+		if (!name || strncmp(name, prefix, prefix_len)) {
+			break;
+		}
+		rz_pvector_push(result, (void *)&lib->types[lo]);
+	}
+	return result;
+}
+
+// Same as c_parser_canonical_type(), resolved when the library is written
+const char *c_type_lib_canonical_type(const CTypeLib *lib, const char *name) {
+	rz_return_val_if_fail(lib && name, NULL);
+	const CTypeLibType *type = c_type_lib_find(lib, name);
+	if (!type || type->kind != C_TYPE_KIND_TYPEDEF) {
+		return name;
+	}
+	const char *canonical = c_type_lib_string(lib, type->canonical);
+	return canonical ? canonical : name;
+}
@@ -0,0 +1,97 @@
+#ifndef TYPES_LIB_H
+#define TYPES_LIB_H
+
+#include <rz_types.h>
+#include <rz_vector.h>
+
+#include <types_parser.h>
+
+// Binary type library, queried in place from the mapped file.
+// All the references are offsets from the start of the file, or
+// record indexes, so the file is position-independent. The
+// records are stored in the native byte order.
+//
+// +--------------+
+// | header       |
+// | types        | CTypeLibType[types_count], sorted by name
+// | members      | CTypeLibMember[members_count], grouped by type
+// | buckets      | ut32[buckets_count], first type of the bucket chain
+// | strings      | NUL-terminated strings, offset 0 is the empty string
+// +--------------+
+
+#define C_TYPE_LIB_MAGIC "RZCTLIB"
+#define C_TYPE_LIB_VERSION 2
+#define C_TYPE_LIB_BYTE_ORDER 0x01020304
+#define C_TYPE_LIB_NONE UT32_MAX
+
+typedef struct {
+	char magic[8];
+	ut32 version;
+	ut32 byte_order; // C_TYPE_LIB_BYTE_ORDER as written by the producer
+	ut32 pointer_size;
+	ut32 types_count;
+	ut32 types_offset;
+	ut32 members_count;
+	ut32 members_offset;
+	ut32 buckets_count; // Power of two
+	ut32 buckets_offset;
+	ut32 strings_size;
+	ut32 strings_offset;
+	ut32 file_size;
+} CTypeLibHeader;
+
+enum {
+	C_TYPE_LIB_ANONYMOUS = 1 << 0,
+	C_TYPE_LIB_FORWARD = 1 << 1,
+	C_TYPE_LIB_LAID_OUT = 1 << 2,
+};
+
+typedef struct {
+	ut64 hash; // Structural hash, see c_type_hash()
+	ut32 name; // String offsets
+	ut32 key; // e.g. "struct S1", the name index key
+	ut32 canonical; // Name the typedef chain ends with, see c_parser_canonical_type()
+	ut32 members; // Index of the first member
+	ut32 members_count;
+	ut32 size;
+	ut32 align;
+	ut32 next; // Next type in the name index bucket, C_TYPE_LIB_NONE if last
+	ut8 kind; // CTypeKind
+	ut8 flags;
+	ut16 reserved;
+} CTypeLibType;
+
+typedef struct {
+	ut32 name; // String offsets, 0 if absent
+	ut32 type;
+	ut32 value;
+	ut32 function; // Signature of the function pointer, e.g. "int (int, char *)"
+	st32 pointers;
+	st32 array;
+	st32 bits;
+	ut32 offset;
+	ut32 bit_offset;
+} CTypeLibMember;
+
+typedef struct {
+	const ut8 *data;
+	size_t size;
+	bool mapped; // Otherwise the data is read into the heap
+	const CTypeLibHeader *header;
+	const CTypeLibType *types;
+	const CTypeLibMember *members;
+	const ut32 *buckets;
+	const char *strings;
+} CTypeLib;
+
+int c_type_lib_save(CParserState *state, const char *path);
+CTypeLib *c_type_lib_open(const char *path);
+void c_type_lib_close(CTypeLib *lib);
+
+const char *c_type_lib_string(const CTypeLib *lib, ut32 offset);
+const CTypeLibType *c_type_lib_find(const CTypeLib *lib, const char *name);
+const CTypeLibMember *c_type_lib_member(const CTypeLib *lib, const CTypeLibType *type, ut32 i);
+RzPVector /*<const CTypeLibType *>*/ *c_type_lib_complete(const CTypeLib *lib, const char *prefix);
+const char *c_type_lib_canonical_type(const CTypeLib *lib, const char *name);
+
+#endif
@@ -2,8 +2,10 @@
 #include <rz_types.h>
 #include <rz_list.h>
 #include <rz_util/rz_str.h>
+#include <rz_util/rz_strbuf.h>
 #include <rz_util/rz_file.h>
 #include <rz_util/rz_assert.h>
+#include <rz_util/rz_time.h>
 #include <rz_type.h>
 #include <tree_sitter/api.h>
 
@@ -30,102 +32,773 @@ static char *ts_node_sub_parent_string(TSNode parent, TSNode node, const char *c
 	return rz_str_newf("%.*s", end - start, cstr + start);
 }
 
-void node_malformed_error(TSNode node, const char *nodetype) {
-	rz_return_if_fail(nodetype && !ts_node_is_null(node));
-	char *string = ts_node_string(node);
-	eprintf("Wrongly formed %s:\n%s\n", nodetype, string);
-	free(string);
+// C++ names are qualified by the enclosing namespaces and classes,
+// takes the ownership of the name
+static char *scoped_name(CParserState *state, char *name) {
+	if (!name || !state->scope) {
+		return name;
+	}
+	char *scoped = rz_str_newf("%s%s", state->scope, name);
+	free(name);
+	return scoped;
 }
 
-CParserState *c_parser_state_new() {
+// Returns the previous scope to be restored by scope_pop()
+static char *scope_push(CParserState *state, const char *name) {
+	char *saved = state->scope;
+	state->scope = rz_str_newf("%s%s::", saved ? saved : "", name);
+	return saved;
+}
+
+static void scope_pop(CParserState *state, char *saved) {
+	free(state->scope);
+	state->scope = saved;
+}
+
+// Records only the node range, the excerpt is rendered later
+// by c_parser_diags_print(), so error-heavy inputs stay fast
+void node_malformed_error(CParserState *state, TSNode node, const char *nodetype) {
+	rz_return_if_fail(state && nodetype && !ts_node_is_null(node));
+	state->stats.malformed++;
+	c_parser_diag_add(state, C_PARSER_DIAG_MALFORMED, node, nodetype);
+}
+
+// Types are owned by the names index
+static void type_kv_free(HtPPKv *kv) {
+	free(kv->key);
+}
+
+static void shape_kv_free(HtUPKv *kv) {
+	rz_list_free(kv->value);
+}
+
+static void dependents_kv_free(HtPPKv *kv) {
+	free(kv->key);
+	rz_vector_free(kv->value);
+}
+
+static CParserState *state_new(CInterner *interner) {
 	CParserState *state = RZ_NEW0(CParserState);
+	if (!state) {
+		return NULL;
+	}
+	state->interner_shared = interner != NULL;
+	state->interner = interner ? interner : c_interner_new();
+	state->intern_cache = state->interner ? c_intern_cache_new(state->interner) : NULL;
+	state->types = ht_pp_new((HtPPDupKey)strdup, type_kv_free, NULL);
+	state->shapes = ht_up_new(NULL, shape_kv_free, NULL);
+	state->dependents = ht_pp_new((HtPPDupKey)strdup, dependents_kv_free, NULL);
+	rz_pvector_init(&state->invalid, NULL);
+	rz_vector_init(&state->diags, sizeof(CParserDiag), NULL, NULL);
+	rz_pvector_init(&state->names, (RzPVectorFree)c_type_free);
+	rz_vector_init(&state->functions, sizeof(CFunction), NULL, NULL);
+	rz_vector_init(&state->param_types, sizeof(ut32), NULL, NULL);
+	rz_vector_init(&state->param_names, sizeof(ut32), NULL, NULL);
+	state->functions_index = ht_pu_new0();
+	rz_vector_init(&state->globals, sizeof(CGlobal), NULL, NULL);
+	state->globals_index = ht_pu_new0();
+	state->pointer_size = 8;
+	state->stats.perf_fd = -1;
+	// Id 0 stands for none
+	CFunction none = { 0 };
+	if (!state->types || !state->shapes || !state->dependents || !state->intern_cache || !state->functions_index || !state->globals_index
+		|| !rz_vector_push(&state->functions, &none)) {
+		c_parser_state_free(state);
+		return NULL;
+	}
 	return state;
 }
 
+CParserState *c_parser_state_new() {
+	return state_new(NULL);
+}
+
+// State of a parallel worker, the interned strings and their
+// ids are shared with the parent, which must outlive the state
+CParserState *c_parser_state_new_shared(CParserState *parent) {
+	rz_return_val_if_fail(parent, NULL);
+	return state_new(parent->interner);
+}
+
 void c_parser_state_free(CParserState *state) {
+	if (!state) {
+		return;
+	}
+	// Shape buckets and the name index only reference the types
+	ht_up_free(state->shapes);
+	ht_pp_free(state->types);
+	ht_pp_free(state->dependents);
+	rz_pvector_fini(&state->invalid);
+	rz_pvector_fini(&state->names);
+	ht_pu_free(state->globals_index);
+	rz_vector_fini(&state->globals);
+	ht_pu_free(state->functions_index);
+	rz_vector_fini(&state->functions);
+	rz_vector_fini(&state->param_types);
+	rz_vector_fini(&state->param_names);
+	c_intern_cache_free(state->intern_cache);
+	if (!state->interner_shared) {
+		c_interner_free(state->interner);
+	}
+	rz_vector_fini(&state->diags);
+	c_line_index_fini(&state->lines);
+	free(state->scope);
 	free(state);
 	return;
 }
 
-// Identifiers can be simple or arrays or pointers or both
+// Moves all the stored types out of the state, e.g. to publish the types
+// of a parallel worker, the state is left without types. Links between
+// the records (shapes, typedef parents, dependencies) are local to the
+// state, thus reset
+bool c_parser_take_types(CParserState *state, RzPVector /*<CType *>*/ *out) {
+	rz_return_val_if_fail(state && out, false);
+	if (rz_pvector_empty(&state->names)) {
+		return true;
+	}
+	HtPP *types = ht_pp_new((HtPPDupKey)strdup, type_kv_free, NULL);
+	HtUP *shapes = ht_up_new(NULL, shape_kv_free, NULL);
+	HtPP *dependents = ht_pp_new((HtPPDupKey)strdup, dependents_kv_free, NULL);
+	if (!types || !shapes || !dependents || !rz_pvector_reserve(out, rz_pvector_len(out) + rz_pvector_len(&state->names))) {
+		ht_pp_free(types);
+		ht_up_free(shapes);
+		ht_pp_free(dependents);
+		return false;
+	}
+	void **it;
+	rz_pvector_foreach (&state->names, it) {
+		CType *type = *it;
+		type->canonical = NULL;
+		type->parent = NULL;
+		type->invalid = false;
+		rz_pvector_push(out, type);
+	}
+	free(rz_pvector_flush(&state->names));
+	state->names_sorted = 0;
+	rz_pvector_clear(&state->invalid);
+	ht_up_free(state->shapes);
+	ht_pp_free(state->types);
+	ht_pp_free(state->dependents);
+	state->shapes = shapes;
+	state->types = types;
+	state->dependents = dependents;
+	return true;
+}
 
-int parse_identifier_node(CParserState *state, TSNode identnode, const char *text) {
-	rz_return_val_if_fail(!ts_node_is_null(identnode), -1);
-	rz_return_val_if_fail(ts_node_is_named(identnode), -1);
-	int ident_node_child_count = ts_node_named_child_count(identnode);
-	if (ident_node_child_count > 2) {
-		node_malformed_error(identnode, "identifier");
-		return -1;
+// Sets the time budget for the next input in microseconds, 0 means unlimited
+void c_parser_set_budget(CParserState *state, ut64 budget) {
+	rz_return_if_fail(state);
+	state->deadline = budget ? rz_time_now_mono() + budget : 0;
+	state->timed_out = false;
+}
+
+// Can be called from any thread, stops both tree-sitter and the walkers
+void c_parser_cancel(CParserState *state) {
+	rz_return_if_fail(state);
+	state->cancel = 1;
+}
+
+// Checked by the walkers for every processed node. Time is checked only
+// every 64 calls, since even the monotonic clock isn't free
+bool c_parser_should_stop(CParserState *state) {
+	if (state->cancel || state->timed_out) {
+		return true;
 	}
-	const char *ident_type = ts_node_type(identnode);
-	if (state->verbose) {
-		printf("ident type: %s\n", ident_type);
+	if (state->deadline && !(++state->stop_checks & 63) && rz_time_now_mono() > state->deadline) {
+		state->timed_out = true;
+		state->stats.budgets_expired++;
+		return true;
 	}
-	if (ident_node_child_count == 0) {
-		// Simple identifier
+	return false;
+}
+
+int parse_struct_node(CParserState *state, TSNode structnode, const char *text, char **tname);
+int parse_union_node(CParserState *state, TSNode unionnode, const char *text, char **tname);
+int parse_enum_node(CParserState *state, TSNode enumnode, const char *text, char **tname);
+int parse_class_node(CParserState *state, TSNode classnode, const char *text, char **tname);
+
+// Returns the name of the field type, e.g. "int" or "struct S2".
+// Nested struct, union or enum definitions are parsed and stored
+// along the way, anonymous ones get the name from the structural hash
+static char *parse_field_type(CParserState *state, TSNode typenode, const char *text) {
+	const char *node_type = ts_node_type(typenode);
+	char *tname = NULL;
+	if (!strcmp(node_type, "class_specifier")
+		|| (!strcmp(node_type, "struct_specifier") && state->lang == C_PARSER_LANG_CPP)) {
+		if (parse_class_node(state, typenode, text, &tname)) {
+			return NULL;
+		}
+	} else if (!strcmp(node_type, "struct_specifier")) {
+		if (parse_struct_node(state, typenode, text, &tname)) {
+			return NULL;
+		}
+	} else if (!strcmp(node_type, "union_specifier")) {
+		if (parse_union_node(state, typenode, text, &tname)) {
+			return NULL;
+		}
+	} else if (!strcmp(node_type, "enum_specifier")) {
+		if (parse_enum_node(state, typenode, text, &tname)) {
+			return NULL;
+		}
 	} else {
-		TSNode ident_type1 = ts_node_named_child(identnode, 0);
-		const char *ident_subtype = ts_node_type(ident_type1);
-		if (state->verbose) {
-			printf("ident subtype: %s\n", ident_subtype);
-		}
-		// Check if it's a pointer
-		// e.g. "float *b;"
-		if (!strcmp(ident_type, "pointer_declarator")) {
-			// Pointer node could ALSO contain array node inside
-			// e.g. "char *arr[20];"
-			if (!strcmp(ident_subtype, "array_declarator")) {
-				int ident_node_child_count = ts_node_named_child_count(ident_type1);
-				if (ident_node_child_count != 2) {
-					node_malformed_error(ident_type1, "identifier");
-					return -1;
-				}
-				TSNode array_ident = ts_node_named_child(ident_type1, 0);
-				TSNode array_size = ts_node_named_child(ident_type1, 1);
-				if (ts_node_is_null(array_ident) || ts_node_is_null(array_size)) {
-					node_malformed_error(identnode, "ptr array identifier");
-					return -1;
+		tname = ts_node_sub_string(typenode, text);
+	}
+	return tname;
+}
+
+#define C_DECLARATOR_DEPTH 16
+
+// Declarator chain around a function, e.g. "*(*name)(int)"
+typedef struct {
+	char *name;
+	int pointers; // Outside of the function declarator, thus of the return type
+	int fn_pointers; // Inside of it, the declarator is a pointer to the function
+	TSNode function; // (function_declarator), null if not a function
+	ut8 callconv;
+	// Pointers (-1) and array sizes outside of the function declarator,
+	// from the base type to the name, e.g. "-1 2 -1" for "*(*d)[2]"
+	int derived[C_DECLARATOR_DEPTH];
+	int derived_count;
+} CDeclarator;
+
+static ut8 callconv_from_text(const char *s) {
+	if (strstr(s, "vectorcall")) {
+		return C_CALLCONV_VECTORCALL;
+	} else if (strstr(s, "fastcall")) {
+		return C_CALLCONV_FASTCALL;
+	} else if (strstr(s, "thiscall")) {
+		return C_CALLCONV_THISCALL;
+	} else if (strstr(s, "stdcall")) {
+		return C_CALLCONV_STDCALL;
+	} else if (strstr(s, "cdecl")) {
+		return C_CALLCONV_CDECL;
+	} else if (strstr(s, "ms_abi")) {
+		return C_CALLCONV_MS_ABI;
+	} else if (strstr(s, "sysv_abi")) {
+		return C_CALLCONV_SYSV_ABI;
+	}
+	return C_CALLCONV_DEFAULT;
+}
+
+// Calling convention attributes can be attached to the declaration
+// or to any declarator, e.g. "int (__stdcall *f)(int);"
+static ut8 parse_callconv(TSNode node, const char *text) {
+	ut8 callconv = C_CALLCONV_DEFAULT;
+	int i, count = ts_node_named_child_count(node);
+	for (i = 0; i < count && !callconv; i++) {
+		TSNode child = ts_node_named_child(node, i);
+		const char *node_type = ts_node_type(child);
+		if (strcmp(node_type, "ms_call_modifier") && strcmp(node_type, "attribute_specifier")
+			&& strcmp(node_type, "attribute_declaration")) {
+			continue;
+		}
+		char *modifier = ts_node_sub_string(child, text);
+		if (modifier) {
+			callconv = callconv_from_text(modifier);
+			free(modifier);
+		}
+	}
+	return callconv;
+}
+
+static bool is_declarator(const char *node_type) {
+	return !strcmp(node_type, "identifier") || !strcmp(node_type, "field_identifier")
+		|| !strcmp(node_type, "type_identifier") || strstr(node_type, "declarator");
+}
+
+// Walks the declarator down to the identifier. Arrays count as
+// pointers, since only the parameters and the function pointers
+// are described this way, where arrays decay. The exact derivations
+// are kept as well for the data members
+static bool parse_declarator_chain(CParserState *state, TSNode node, const char *text, CDeclarator *decl) {
+	while (!ts_node_is_null(node)) {
+		const char *node_type = ts_node_type(node);
+		ut8 callconv = parse_callconv(node, text);
+		if (callconv) {
+			decl->callconv = callconv;
+		}
+		if (!strcmp(node_type, "pointer_declarator") || !strcmp(node_type, "abstract_pointer_declarator")
+			|| !strcmp(node_type, "array_declarator") || !strcmp(node_type, "abstract_array_declarator")) {
+			if (ts_node_is_null(decl->function)) {
+				if (decl->derived_count == C_DECLARATOR_DEPTH) {
+					return false;
 				}
-				const char *real_array_ident = ts_node_sub_string(array_ident, text);
-				const char *real_array_size = ts_node_sub_string(array_size, text);
-				if (!real_array_ident || !real_array_size) {
-					node_malformed_error(identnode, "ptr array identifier");
-					return -1;
+				int derived = -1;
+				if (strstr(node_type, "array")) {
+					TSNode size_node = ts_node_child_by_field_name(node, "size", strlen("size"));
+					char *size = ts_node_is_null(size_node) ? NULL : ts_node_sub_string(size_node, text);
+					// "int a[];" has no size
+					derived = size ? atoi(size) : 0;
+					free(size);
 				}
-				int array_sz = atoi(real_array_size);
-				printf("array pointers of to %s size %d\n", real_array_ident, array_sz);
-			} else if (!strcmp(ident_subtype, "field_identifier")) {
-				const char *ptr_ident = ts_node_sub_string(ident_type1, text);
-				printf("simple pointer to %s\n", ptr_ident);
+				decl->derived[decl->derived_count++] = derived;
+				decl->pointers++;
 			} else {
-				node_malformed_error(identnode, "identifier");
-				return -1;
+				decl->fn_pointers++;
 			}
-		// Or an array
-		// e.g. "int a[10];"
-		} else if (!strcmp(ident_type, "array_declarator")) {
-			int array_node_child_count = ts_node_named_child_count(identnode);
-			if (array_node_child_count != 2) {
-				node_malformed_error(identnode, "array identifier");
-				return -1;
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else if (!strcmp(node_type, "function_declarator") || !strcmp(node_type, "abstract_function_declarator")) {
+			if (!ts_node_is_null(decl->function)) {
+				// Functions returning function pointers are not supported yet
+				return false;
 			}
-			TSNode array_ident = ts_node_named_child(identnode, 0);
-			TSNode array_size = ts_node_named_child(identnode, 1);
-			if (ts_node_is_null(array_ident) || ts_node_is_null(array_size)) {
-				node_malformed_error(identnode, "array identifier");
-				return -1;
+			decl->function = node;
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else if (!strcmp(node_type, "parenthesized_declarator") || !strcmp(node_type, "abstract_parenthesized_declarator")) {
+			TSNode inner = { 0 };
+			int i, count = ts_node_named_child_count(node);
+			for (i = 0; i < count; i++) {
+				TSNode child = ts_node_named_child(node, i);
+				if (is_declarator(ts_node_type(child))) {
+					inner = child;
+					break;
+				}
 			}
-			const char *real_array_ident = ts_node_sub_string(array_ident, text);
-			const char *real_array_size = ts_node_sub_string(array_size, text);
-			if (!real_array_ident || !real_array_size) {
-				node_malformed_error(identnode, "array identifier");
+			node = inner;
+		} else if (!strcmp(node_type, "identifier") || !strcmp(node_type, "field_identifier")
+			|| !strcmp(node_type, "type_identifier")) {
+			decl->name = ts_node_sub_string(node, text);
+			return decl->name != NULL;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool declarator_is_function(CParserState *state, TSNode node, const char *text) {
+	CDeclarator decl = { 0 };
+	bool ok = parse_declarator_chain(state, node, text, &decl);
+	free(decl.name);
+	return ok && !ts_node_is_null(decl.function);
+}
+
+// Returns e.g. "char **" for "char" and 2 pointers
+static char *pointer_type_string(const char *base, int pointers) {
+	if (!pointers) {
+		return strdup(base);
+	}
+	RzStrBuf *sb = rz_strbuf_new(base);
+	if (!sb) {
+		return NULL;
+	}
+	rz_strbuf_append(sb, " ");
+	while (pointers--) {
+		rz_strbuf_append(sb, "*");
+	}
+	return rz_strbuf_drain(sb);
+}
+
+// Type of the declaration with the qualifiers, e.g. "const char"
+static char *parse_declaration_type(CParserState *state, TSNode node, const char *text) {
+	TSNode typenode = ts_node_child_by_field_name(node, "type", strlen("type"));
+	if (ts_node_is_null(typenode)) {
+		return NULL;
+	}
+	char *type = parse_field_type(state, typenode, text);
+	if (!type) {
+		return NULL;
+	}
+	int i, count = ts_node_named_child_count(node);
+	for (i = count - 1; i >= 0; i--) {
+		TSNode child = ts_node_named_child(node, i);
+		if (strcmp(ts_node_type(child), "type_qualifier")) {
+			continue;
+		}
+		char *qualifier = ts_node_sub_string(child, text);
+		char *qualified = qualifier ? rz_str_newf("%s %s", qualifier, type) : NULL;
+		free(qualifier);
+		if (qualified) {
+			free(type);
+			type = qualified;
+		}
+	}
+	return type;
+}
+
+static ut32 parse_function_signature(CParserState *state, const char *ret, CDeclarator *decl, const char *name, const char *text);
+
+// Appends the parameter type ids and names, "(void)" has no parameters
+static int parse_parameters(CParserState *state, TSNode paramsnode, const char *text, CFunction *fn, RzVector *types, RzVector *names) {
+	int i, count = ts_node_named_child_count(paramsnode);
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(paramsnode, i);
+		state->stats.nodes++;
+		const char *node_type = ts_node_type(child);
+		if (!strcmp(node_type, "variadic_parameter")) {
+			fn->variadic = true;
+			continue;
+		} else if (strcmp(node_type, "parameter_declaration")) {
+			// e.g. comments
+			continue;
+		}
+		char *base = parse_declaration_type(state, child, text);
+		if (!base) {
+			node_malformed_error(state, child, "function parameter");
+			return -1;
+		}
+		CDeclarator decl = { 0 };
+		TSNode declnode = ts_node_child_by_field_name(child, "declarator", strlen("declarator"));
+		if (!parse_declarator_chain(state, declnode, text, &decl)) {
+			node_malformed_error(state, child, "function parameter");
+			free(base);
+			free(decl.name);
+			return -1;
+		}
+		char *type = NULL;
+		if (!ts_node_is_null(decl.function)) {
+			// Function pointer parameter, e.g. "void (*cb)(int)"
+			ut32 id = parse_function_signature(state, base, &decl, NULL, text);
+			const CFunction *param_fn = c_parser_function(state, id);
+			type = param_fn ? pointer_type_string(c_parser_atom(state, param_fn->type), RZ_MAX(decl.fn_pointers, 1)) : NULL;
+		} else if (count == 1 && !decl.pointers && !decl.name && !strcmp(base, "void")) {
+			free(base);
+			break;
+		} else {
+			type = pointer_type_string(base, decl.pointers);
+		}
+		free(base);
+		if (!type) {
+			node_malformed_error(state, child, "function parameter");
+			free(decl.name);
+			return -1;
+		}
+		ut32 type_id = c_parser_intern(state, type);
+		ut32 name_id = c_parser_intern(state, decl.name);
+		free(type);
+		free(decl.name);
+		rz_vector_push(types, &type_id);
+		rz_vector_push(names, &name_id);
+	}
+	return 0;
+}
+
+// Stores the signature of the function declarator, the return type is
+// the base type of the declaration with the pointers outside of the
+// function declarator. Returns the function id, 0 on failure
+static ut32 parse_function_signature(CParserState *state, const char *ret, CDeclarator *decl, const char *name, const char *text) {
+	CFunction fn = { 0 };
+	fn.callconv = decl->callconv;
+	fn.name = c_parser_intern(state, name);
+	char *ret_type = pointer_type_string(ret, decl->pointers);
+	fn.ret = c_parser_intern(state, ret_type);
+	free(ret_type);
+	if (!fn.ret || (name && !fn.name)) {
+		return 0;
+	}
+	RzVector types, names;
+	rz_vector_init(&types, sizeof(ut32), NULL, NULL);
+	rz_vector_init(&names, sizeof(ut32), NULL, NULL);
+	TSNode paramsnode = ts_node_child_by_field_name(decl->function, "parameters", strlen("parameters"));
+	ut32 id = 0;
+	if (!ts_node_is_null(paramsnode) && !parse_parameters(state, paramsnode, text, &fn, &types, &names)) {
+		id = c_parser_store_function(state, &fn, &types, &names);
+	}
+	rz_vector_fini(&types);
+	rz_vector_fini(&names);
+	return id;
+}
+
+// Function pointer field or typedef, e.g. "int (*some_func)(uint32_t a);"
+// The member type holds the return type on entry, and is replaced by the
+// signature type, so the layouts see just a pointer
+static int parse_function_member(CParserState *state, TSNode declnode, const char *text, CTypeMember *member) {
+	CDeclarator decl = { 0 };
+	if (!parse_declarator_chain(state, declnode, text, &decl) || ts_node_is_null(decl.function) || !decl.name) {
+		node_malformed_error(state, declnode, "function pointer");
+		free(decl.name);
+		return -1;
+	}
+	ut32 id = parse_function_signature(state, member->type, &decl, NULL, text);
+	const CFunction *fn = c_parser_function(state, id);
+	char *type = fn ? strdup(c_parser_atom(state, fn->type)) : NULL;
+	if (!type) {
+		free(decl.name);
+		return -1;
+	}
+	free(member->type);
+	member->type = type;
+	member->name = decl.name;
+	member->pointers = decl.fn_pointers;
+	member->function = id;
+	return 0;
+}
+
+// Type name of the derivations, from the base type to the name,
+// e.g. "int *[2]" for "int" and a pointer followed by an array of 2
+static char *derived_type_string(const char *base, const int *derived, int count) {
+	char *decl = strdup("");
+	int i;
+	for (i = count - 1; i >= 0 && decl; i--) {
+		char *next;
+		if (derived[i] < 0) {
+			next = rz_str_newf("*%s", decl);
+		} else if (*decl == '*') {
+			next = rz_str_newf("(%s)[%d]", decl, derived[i]);
+		} else {
+			next = rz_str_newf("%s[%d]", decl, derived[i]);
+		}
+		free(decl);
+		decl = next;
+	}
+	char *type = decl ? rz_str_newf("%s %s", base, decl) : NULL;
+	free(decl);
+	return type;
+}
+
+// Data member declarator, e.g. "*names[4]" or "*(*rows)[2]". The arrays
+// next to the name make the member an array, with the dimensions
+// multiplied, and the pointers before them are the member pointers.
+// The rest of the derivations stays in the member type, e.g. "int *[2]"
+// for the rows. Flexible array members are not supported
+static int parse_field_declarator(CParserState *state, TSNode node, const char *text, CTypeMember *member) {
+	CDeclarator decl = { 0 };
+	if (!parse_declarator_chain(state, node, text, &decl) || !ts_node_is_null(decl.function) || !decl.name) {
+		goto error;
+	}
+	int k = decl.derived_count;
+	int array = 0;
+	while (k > 0 && decl.derived[k - 1] >= 0) {
+		int elements = decl.derived[--k];
+		if (!elements) {
+			goto error;
+		}
+		array = array ? array * elements : elements;
+	}
+	int pointers = 0;
+	while (k > 0 && decl.derived[k - 1] < 0) {
+		pointers++;
+		k--;
+	}
+	if (k > 0) {
+		char *type = derived_type_string(member->type, decl.derived, k);
+		if (!type) {
+			goto error;
+		}
+		free(member->type);
+		member->type = type;
+	}
+	member->name = decl.name;
+	member->pointers = pointers;
+	member->array = array;
+	return 0;
+error:
+	node_malformed_error(state, node, "field declarator");
+	free(decl.name);
+	return -1;
+}
+
+// Field of a struct or union, e.g. "int a, *b[2];" or "unsigned f : 3;"
+// A member with an unsupported declarator is skipped with a diagnostic,
+// the rest of the aggregate is stored as usual
+static int parse_field_declaration(CParserState *state, CType *type, TSNode field, const char *text, const char *what) {
+	TSNode typenode = ts_node_child_by_field_name(field, "type", strlen("type"));
+	if (ts_node_is_null(typenode)) {
+		node_malformed_error(state, field, what);
+		return -1;
+	}
+	char *base = parse_field_type(state, typenode, text);
+	if (!base) {
+		node_malformed_error(state, field, what);
+		return -1;
+	}
+	if (state->verbose) {
+		printf("field type: %s\n", base);
+	}
+	int declarators = 0;
+	int i, count = ts_node_named_child_count(field);
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(field, i);
+		if (ts_node_eq(child, typenode) || !is_declarator(ts_node_type(child))) {
+			continue;
+		}
+		declarators++;
+		CTypeMember member = { 0 };
+		member.type = strdup(base);
+		if (!member.type) {
+			free(base);
+			return -1;
+		}
+		int result = declarator_is_function(state, child, text)
+			? parse_function_member(state, child, text, &member)
+			: parse_field_declarator(state, child, text, &member);
+		if (result) {
+			free(member.type);
+			continue;
+		}
+		// "int a : 3;"
+		TSNode next = ts_node_next_named_sibling(child);
+		if (!ts_node_is_null(next) && !strcmp(ts_node_type(next), "bitfield_clause")) {
+			char *bits = ts_node_sub_string(ts_node_named_child(next, 0), text);
+			member.bits = bits ? atoi(bits) : 0;
+			free(bits);
+		}
+		if (state->verbose) {
+			printf("field: %s pointers: %d array: %d bits: %d\n", member.name, member.pointers, member.array, member.bits);
+		}
+		rz_vector_push(&type->members, &member);
+	}
+	// Anonymous struct or union member, while the named nested
+	// types without a declarator are only the definitions
+	if (!declarators && ts_node_is_null(ts_node_child_by_field_name(typenode, "name", strlen("name")))
+		&& !ts_node_is_null(ts_node_child_by_field_name(typenode, "body", strlen("body")))) {
+		CTypeMember member = { .type = base };
+		rz_vector_push(&type->members, &member);
+		return 0;
+	}
+	free(base);
+	return 0;
+}
+
+// Declarator of a global object, e.g. "*names[4]". The dimensions of
+// the multidimensional arrays are multiplied
+static bool parse_object_declarator(CParserState *state, TSNode node, const char *text, CGlobal *global, char **name) {
+	while (!ts_node_is_null(node)) {
+		const char *node_type = ts_node_type(node);
+		if (!strcmp(node_type, "pointer_declarator")) {
+			global->pointers++;
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else if (!strcmp(node_type, "array_declarator")) {
+			TSNode size_node = ts_node_child_by_field_name(node, "size", strlen("size"));
+			char *size = ts_node_is_null(size_node) ? NULL : ts_node_sub_string(size_node, text);
+			// "extern int a[];" has no size
+			int elements = size ? atoi(size) : 0;
+			free(size);
+			global->array = global->array ? global->array * elements : elements;
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else if (!strcmp(node_type, "parenthesized_declarator")) {
+			node = ts_node_named_child(node, 0);
+		} else if (!strcmp(node_type, "identifier")) {
+			*name = ts_node_sub_string(node, text);
+			return *name != NULL;
+		} else {
+			return false;
+		}
+	}
+	return false;
+}
+
+static ut8 parse_storage_class(TSNode declnode, const char *text) {
+	ut8 storage = 0;
+	int i, count = ts_node_named_child_count(declnode);
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(declnode, i);
+		if (strcmp(ts_node_type(child), "storage_class_specifier")) {
+			continue;
+		}
+		char *specifier = ts_node_sub_string(child, text);
+		if (!specifier) {
+			continue;
+		}
+		if (!strcmp(specifier, "extern")) {
+			storage |= C_STORAGE_EXTERN;
+		} else if (!strcmp(specifier, "static")) {
+			storage |= C_STORAGE_STATIC;
+		} else if (!strcmp(specifier, "__thread") || !strcmp(specifier, "_Thread_local")
+			|| !strcmp(specifier, "thread_local")) {
+			storage |= C_STORAGE_THREAD_LOCAL;
+		}
+		free(specifier);
+	}
+	return storage;
+}
+
+// Global object or function pointer variable, e.g. "extern int a[4];"
+// or "void (*handler)(int);"
+static int parse_global_declarator(CParserState *state, TSNode declnode, TSNode child, const char *base, const char *text) {
+	CGlobal global = { 0 };
+	global.storage = parse_storage_class(declnode, text);
+	global.defined = !(global.storage & C_STORAGE_EXTERN);
+	global.base = c_parser_intern(state, base);
+	char *name = NULL;
+	char *type = NULL;
+	if (declarator_is_function(state, child, text)) {
+		CDeclarator decl = { .callconv = parse_callconv(declnode, text) };
+		parse_declarator_chain(state, child, text, &decl);
+		name = decl.name;
+		global.function = parse_function_signature(state, base, &decl, NULL, text);
+		const CFunction *fn = c_parser_function(state, global.function);
+		global.pointers = decl.fn_pointers;
+		type = fn ? pointer_type_string(c_parser_atom(state, fn->type), decl.fn_pointers) : NULL;
+	} else if (parse_object_declarator(state, child, text, &global, &name)) {
+		type = pointer_type_string(base, global.pointers);
+		if (type && global.array) {
+			char *array_type = rz_str_newf("%s%s[%d]", type, global.pointers ? "" : " ", global.array);
+			free(type);
+			type = array_type;
+		}
+	}
+	name = scoped_name(state, name);
+	if (!name || !type) {
+		node_malformed_error(state, child, "global declaration");
+		free(name);
+		free(type);
+		return -1;
+	}
+	global.name = c_parser_intern(state, name);
+	global.type = c_parser_intern(state, type);
+	if (state->verbose) {
+		printf("global: %s type: %s%s\n", name, type, global.defined ? "" : " (extern)");
+	}
+	free(name);
+	free(type);
+	if (!global.name || !global.type || !c_parser_store_global(state, &global)) {
+		return -1;
+	}
+	return 0;
+}
+
+// Prototypes, function definitions and global objects, e.g.
+// "char *strdup(const char *s);" or "extern int errno;"
+// The types declared along the way are stored as usual
+static int parse_declaration_node(CParserState *state, TSNode declnode, const char *text) {
+	int i, count = ts_node_named_child_count(declnode);
+	TSNode typenode = ts_node_child_by_field_name(declnode, "type", strlen("type"));
+	if (ts_node_is_null(typenode)) {
+		node_malformed_error(state, declnode, "declaration");
+		return -1;
+	}
+	char *base = NULL;
+	ut8 callconv = parse_callconv(declnode, text);
+	int result = 0;
+	for (i = 0; i < count && !result; i++) {
+		TSNode child = ts_node_named_child(declnode, i);
+		const char *node_type = ts_node_type(child);
+		if (ts_node_eq(child, typenode) || !is_declarator(node_type)) {
+			continue;
+		}
+		if (!base) {
+			base = parse_declaration_type(state, declnode, text);
+			if (!base) {
+				node_malformed_error(state, declnode, "declaration");
 				return -1;
 			}
-			int array_sz = atoi(real_array_size);
-			printf("simple array of to %s size %d\n", real_array_ident, array_sz);
 		}
+		if (!strcmp(node_type, "init_declarator")) {
+			// "int a = 1;"
+			child = ts_node_child_by_field_name(child, "declarator", strlen("declarator"));
+		}
+		CDeclarator decl = { .callconv = callconv };
+		if (!declarator_is_function(state, child, text)
+			|| (parse_declarator_chain(state, child, text, &decl) && decl.fn_pointers)) {
+			free(decl.name);
+			result = parse_global_declarator(state, declnode, child, base, text);
+			continue;
+		}
+		if (!decl.name) {
+			continue;
+		}
+		decl.name = scoped_name(state, decl.name);
+		ut32 id = parse_function_signature(state, base, &decl, decl.name, text);
+		if (id && state->verbose) {
+			char *signature = c_parser_function_string(state, c_parser_function(state, id));
+			printf("function: %s\n", signature);
+			free(signature);
+		}
+		free(decl.name);
 	}
-	return 0;
+	free(base);
+	return result;
 }
 
 // Types can be
@@ -135,442 +808,450 @@ int parse_identifier_node(CParserState *state, TSNode identnode, const char *tex
 // - typedef (type_definition)
 // - atomic type
 
-
-int parse_struct_node(CParserState *state, TSNode structnode, const char *text) {
+int parse_struct_node(CParserState *state, TSNode structnode, const char *text, char **tname) {
 	rz_return_val_if_fail(!ts_node_is_null(structnode), -1);
 	rz_return_val_if_fail(ts_node_is_named(structnode), -1);
 	int struct_node_child_count = ts_node_named_child_count(structnode);
 	if (struct_node_child_count < 1 || struct_node_child_count > 2) {
-		node_malformed_error(structnode, "struct");
+		node_malformed_error(state, structnode, "struct");
 		return -1;
 	}
+	char *realname = NULL;
+	TSNode struct_body;
 	if (struct_node_child_count < 2) {
 		// Anonymous or forward declaration struct
 		TSNode child = ts_node_child(structnode, 1);
 		if (!ts_node_is_null(child) && ts_node_is_named(child)) {
 			const char *node_type = ts_node_type(child);
 			if (!node_type) {
-				node_malformed_error(structnode, "struct");
+				node_malformed_error(state, structnode, "struct");
 				return -1;
 			}
 			// "struct bla;"
 			if (!strcmp(node_type, "type_identifier")) {
-				// We really skip such declarations since they don't
-				// make sense for our goal
+				// Forward declaration, the definition may come later
+				// or from another header. References like "struct bla *p;"
+				// need only the name
+				char *name = scoped_name(state, ts_node_sub_string(child, text));
+				if (!name) {
+					node_malformed_error(state, structnode, "struct");
+					return -1;
+				}
+				if (tname) {
+					*tname = c_type_key(C_TYPE_KIND_STRUCT, name);
+				} else {
+					CType *type = c_type_new(C_TYPE_KIND_STRUCT, name);
+					if (type) {
+						type->forward = true;
+						c_parser_store_type(state, type);
+					}
+				}
+				free(name);
+				return 0;
 			// Anonymous struct, "struct { int a; int b; };"
 			} else if (!strcmp(node_type, "field_declaration_list")) {
-				// FIXME: Support anonymous structures
-				eprintf("Anonymous structs aren't supported yet!\n");
-				return -1;
+				struct_body = child;
 			} else {
-				node_malformed_error(structnode, "struct");
+				node_malformed_error(state, structnode, "struct");
 				return -1;
 			}
 		} else {
-			node_malformed_error(structnode, "struct");
+			node_malformed_error(state, structnode, "struct");
 			return -1;
 		}
+	} else {
+		TSNode struct_name = ts_node_named_child(structnode, 0);
+		struct_body = ts_node_named_child(structnode, 1);
+		realname = scoped_name(state, ts_node_sub_string(struct_name, text));
+		if (!realname) {
+			eprintf("ERROR: Struct name should not be NULL!\n");
+			node_malformed_error(state, structnode, "struct");
+			return -1;
+		}
+		if (state->verbose) {
+			printf("struct name: %s\n", realname);
+		}
 	}
-	TSNode struct_name = ts_node_named_child(structnode, 0);
-	TSNode struct_body = ts_node_named_child(structnode, 1);
 	int body_child_count = ts_node_named_child_count(struct_body);
-	const char *realname = ts_node_sub_string(struct_name, text);
-	if (!realname || !body_child_count) {
-		eprintf("ERROR: Struct name should not be NULL!\n");
-		node_malformed_error(structnode, "struct");
+	if (!body_child_count) {
+		eprintf("ERROR: Struct body should not be empty!\n");
+		node_malformed_error(state, structnode, "struct");
+		free(realname);
+		return -1;
+	}
+	CType *type = c_type_new(C_TYPE_KIND_STRUCT, realname);
+	free(realname);
+	if (!type) {
 		return -1;
 	}
-	printf("struct name: %s\n", realname);
 	int i;
 	for (i = 0; i < body_child_count; i++) {
 		if (state->verbose) {
 			printf("struct: processing %d field...\n", i);
 		}
+		// Partially parsed struct is dropped when the budget expires
+		if (c_parser_should_stop(state)) {
+			goto error;
+		}
 		TSNode child = ts_node_named_child(struct_body, i);
+		state->stats.nodes++;
 		const char *node_type = ts_node_type(child);
 		// Every field should have (field_declaration) AST clause
 		if (strcmp(node_type, "field_declaration")) {
 			eprintf("ERROR: Struct field AST should contain (field_declaration) node!\n");
-			node_malformed_error(child, "struct field");
-			return -1;
-		}
-		// Every field node should have at least 2 children!
-		int field_child_count = ts_node_named_child_count(child);
-		if (field_child_count < 2 || field_child_count > 3) {
-			eprintf("ERROR: Struct field AST cannot contain less than 2 or more than 3 items");
-			node_malformed_error(child, "struct field");
-			return -1;
+			node_malformed_error(state, child, "struct field");
+			goto error;
 		}
-		// Every field can be:
-		// - atomic: "int a;" or "char b[20]"
-		// - bitfield: int a:7;"
-		// - nested: "struct { ... } a;" or "union { ... } a;"
 		if (state->verbose) {
-			const char *fieldtext = ts_node_sub_string(child, text);
+			char *fieldtext = ts_node_sub_string(child, text);
 			char *nodeast = ts_node_string(child);
 			if (fieldtext && nodeast) {
 				printf("field text: %s\n", fieldtext);
 				printf("field ast: %s\n", nodeast);
 			}
+			free(fieldtext);
 			free(nodeast);
 		}
-		// 1st case, bitfield
-		// AST looks like
-		// type: (primitive_type) declarator: (field_identifier) (bitfield_clause (number_literal))
-		// Thus it has exactly 3 children
-		if (field_child_count == 3) {
-			TSNode field_type = ts_node_named_child(child, 0);
-			TSNode field_identifier = ts_node_named_child(child, 1);
-			TSNode field_bitfield = ts_node_named_child(child, 2);
-			if (ts_node_is_null(field_type)
-					|| ts_node_is_null(field_identifier)
-					|| ts_node_is_null(field_bitfield)) {
-				eprintf("ERROR: Struct bitfield type should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			// As per C standard bitfields are defined only for atomic types, particularly "int"
-			if (strcmp(ts_node_type(field_type), "primitive_type")) {
-				eprintf("ERROR: Struct bitfield cannot contain non-primitive bitfield!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			const char *real_type = ts_node_sub_string(field_type, text);
-			if (!real_type) {
-				eprintf("ERROR: Struct bitfield type should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			const char *real_identifier = ts_node_sub_string(field_identifier, text);
-			if (!real_identifier) {
-				eprintf("ERROR: Struct bitfield identifier should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			if (ts_node_named_child_count(field_bitfield) != 1) {
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			TSNode field_bits = ts_node_named_child(field_bitfield, 0);
-			if (ts_node_is_null(field_bits)) {
-				eprintf("ERROR: Struct bitfield bits AST node should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			const char *bits_str = ts_node_sub_string(field_bits, text);
-			int bits = atoi(bits_str);
-			eprintf("field type: %s field_identifier: %s bits: %d\n", real_type, real_identifier, bits);
-		} else {
-			printf("field children: %d\n", field_child_count);
-			TSNode field_type = ts_node_named_child(child, 0);
-			TSNode field_identifier = ts_node_named_child(child, 1);
-			if (ts_node_is_null(field_type) || ts_node_is_null(field_identifier)) {
-				eprintf("ERROR: Struct field type and identifier should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
-			}
-			if (!strcmp(ts_node_type(field_type), "primitive_type")) {
-				// 2nd case, atomic field
-				// AST looks like
-				// type: (primitive_type) declarator: (field_identifier)
-				const char *real_type = ts_node_sub_string(field_type, text);
-				if (!real_type) {
-					eprintf("ERROR: Struct field type should not be NULL!\n");
-					node_malformed_error(child, "struct field");
-					return -1;
-				}
-				const char *real_identifier = ts_node_sub_string(field_identifier, text);
-				if (!real_identifier) {
-					eprintf("ERROR: Struct bitfield identifier should not be NULL!\n");
-					node_malformed_error(child, "struct field");
-					return -1;
-				}
-				eprintf("field type: %s field_identifier: %s\n", real_type, real_identifier);
-				parse_identifier_node(state, field_identifier, text);
-			} else {
-				// 3rd case, complex type
-				// AST looks like
-				// type: (struct_specifier ...) declarator: (field_identifier)
-			}
+		// Every field can be:
+		// - atomic: "int a;" or "char b[20]"
+		// - bitfield: "int a:7;"
+		// - nested: "struct { ... } a;" or "union { ... } a;"
+		// - anonymous nested: "struct { ... };" or "union { ... };"
+		if (parse_field_declaration(state, type, child, text, "struct field")) {
+			goto error;
 		}
 	}
+	type = c_parser_store_type(state, type);
+	if (!type) {
+		return -1;
+	}
+	if (type->anonymous && state->verbose) {
+		printf("anonymous struct name: %s\n", type->name);
+	}
+	if (tname) {
+		*tname = c_type_key(type->kind, type->name);
+	}
 	return 0;
+error:
+	c_type_free(type);
+	return -1;
 }
 
 // Union is almost exact copy of struct but size computation is different
-int parse_union_node(CParserState *state, TSNode unionnode, const char *text) {
+int parse_union_node(CParserState *state, TSNode unionnode, const char *text, char **tname) {
 	rz_return_val_if_fail(!ts_node_is_null(unionnode), -1);
 	rz_return_val_if_fail(ts_node_is_named(unionnode), -1);
 	int union_node_child_count = ts_node_named_child_count(unionnode);
 	if (union_node_child_count < 1 || union_node_child_count > 2) {
-		node_malformed_error(unionnode, "union");
+		node_malformed_error(state, unionnode, "union");
 		return -1;
 	}
+	char *realname = NULL;
+	TSNode union_body;
 	if (union_node_child_count < 2) {
 		// Anonymous or forward declaration union
 		TSNode child = ts_node_child(unionnode, 1);
 		if (!ts_node_is_null(child) && ts_node_is_named(child)) {
 			const char *node_type = ts_node_type(child);
 			if (!node_type) {
-				node_malformed_error(unionnode, "union");
+				node_malformed_error(state, unionnode, "union");
 				return -1;
 			}
 			// "union bla;"
 			if (!strcmp(node_type, "type_identifier")) {
-				// We really skip such declarations since they don't
-				// make sense for our goal
+				// Forward declaration, the definition may come later
+				// or from another header. References like "union bla *p;"
+				// need only the name
+				char *name = scoped_name(state, ts_node_sub_string(child, text));
+				if (!name) {
+					node_malformed_error(state, unionnode, "union");
+					return -1;
+				}
+				if (tname) {
+					*tname = c_type_key(C_TYPE_KIND_UNION, name);
+				} else {
+					CType *type = c_type_new(C_TYPE_KIND_UNION, name);
+					if (type) {
+						type->forward = true;
+						c_parser_store_type(state, type);
+					}
+				}
+				free(name);
+				return 0;
 			// Anonymous union, "union { int a; float b; };"
 			} else if (!strcmp(node_type, "field_declaration_list")) {
-				// FIXME: Support anonymous unions
-				eprintf("Anonymous unions aren't supported yet!\n");
-				return -1;
+				union_body = child;
 			} else {
-				node_malformed_error(unionnode, "union");
+				node_malformed_error(state, unionnode, "union");
 				return -1;
 			}
 		} else {
-			node_malformed_error(unionnode, "union");
+			node_malformed_error(state, unionnode, "union");
+			return -1;
+		}
+	} else {
+		TSNode union_name = ts_node_named_child(unionnode, 0);
+		union_body = ts_node_named_child(unionnode, 1);
+		realname = scoped_name(state, ts_node_sub_string(union_name, text));
+		if (!realname) {
+			eprintf("ERROR: union name should not be NULL!\n");
+			node_malformed_error(state, unionnode, "union");
 			return -1;
 		}
+		if (state->verbose) {
+			printf("union name: %s\n", realname);
+		}
 	}
-	TSNode union_name = ts_node_named_child(unionnode, 0);
-	TSNode union_body = ts_node_named_child(unionnode, 1);
 	int body_child_count = ts_node_named_child_count(union_body);
-	const char *realname = ts_node_sub_string(union_name, text);
-	if (!realname || !body_child_count) {
-		eprintf("ERROR: union name should not be NULL!\n");
-		node_malformed_error(unionnode, "union");
+	if (!body_child_count) {
+		eprintf("ERROR: union body should not be empty!\n");
+		node_malformed_error(state, unionnode, "union");
+		free(realname);
+		return -1;
+	}
+	CType *type = c_type_new(C_TYPE_KIND_UNION, realname);
+	free(realname);
+	if (!type) {
 		return -1;
 	}
-	printf("union name: %s\n", realname);
 	int i;
 	for (i = 0; i < body_child_count; i++) {
 		if (state->verbose) {
 			printf("union: processing %d field...\n", i);
 		}
+		// Partially parsed union is dropped when the budget expires
+		if (c_parser_should_stop(state)) {
+			goto error;
+		}
 		TSNode child = ts_node_named_child(union_body, i);
+		state->stats.nodes++;
 		const char *node_type = ts_node_type(child);
 		// Every field should have (field_declaration) AST clause
 		if (strcmp(node_type, "field_declaration")) {
 			eprintf("ERROR: union field AST should contain (field_declaration) node!\n");
-			node_malformed_error(child, "union field");
-			return -1;
+			node_malformed_error(state, child, "union field");
+			goto error;
 		}
-		// Every field node should have at least 2 children!
-		int field_child_count = ts_node_named_child_count(child);
-		if (field_child_count < 2 || field_child_count > 3) {
-			eprintf("ERROR: union field AST cannot contain less than 2 or more than 3 items");
-			node_malformed_error(child, "union field");
-			return -1;
-		}
-		// Every field can be:
-		// - atomic: "int a;" or "char b[20]"
-		// - bitfield: int a:7;"
-		// - nested: "union { ... } a;" or "union { ... } a;"
 		if (state->verbose) {
-			const char *fieldtext = ts_node_sub_string(child, text);
+			char *fieldtext = ts_node_sub_string(child, text);
 			char *nodeast = ts_node_string(child);
 			if (fieldtext && nodeast) {
 				printf("field text: %s\n", fieldtext);
 				printf("field ast: %s\n", nodeast);
 			}
+			free(fieldtext);
 			free(nodeast);
 		}
-		// 1st case, bitfield
-		// AST looks like
-		// type: (primitive_type) declarator: (field_identifier) (bitfield_clause (number_literal))
-		// Thus it has exactly 3 children
-		if (field_child_count == 3) {
-			// Note, this case is very tricky to compute allocation in memory
-			// and very rare in practice
-			TSNode field_type = ts_node_named_child(child, 0);
-			TSNode field_identifier = ts_node_named_child(child, 1);
-			TSNode field_bitfield = ts_node_named_child(child, 2);
-			if (ts_node_is_null(field_type)
-					|| ts_node_is_null(field_identifier)
-					|| ts_node_is_null(field_bitfield)) {
-				eprintf("ERROR: union bitfield type should not be NULL!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			// As per C standard bitfields are defined only for atomic types, particularly "int"
-			if (strcmp(ts_node_type(field_type), "primitive_type")) {
-				eprintf("ERROR: union bitfield cannot contain non-primitive bitfield!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			const char *real_type = ts_node_sub_string(field_type, text);
-			if (!real_type) {
-				eprintf("ERROR: union bitfield type should not be NULL!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			const char *real_identifier = ts_node_sub_string(field_identifier, text);
-			if (!real_identifier) {
-				eprintf("ERROR: union bitfield identifier should not be NULL!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			if (ts_node_named_child_count(field_bitfield) != 1) {
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			TSNode field_bits = ts_node_named_child(field_bitfield, 0);
-			if (ts_node_is_null(field_bits)) {
-				eprintf("ERROR: union bitfield bits AST node should not be NULL!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			const char *bits_str = ts_node_sub_string(field_bits, text);
-			int bits = atoi(bits_str);
-			eprintf("field type: %s field_identifier: %s bits: %d\n", real_type, real_identifier, bits);
-		} else {
-			printf("field children: %d\n", field_child_count);
-			TSNode field_type = ts_node_named_child(child, 0);
-			TSNode field_identifier = ts_node_named_child(child, 1);
-			if (ts_node_is_null(field_type) || ts_node_is_null(field_identifier)) {
-				eprintf("ERROR: union field type and identifier should not be NULL!\n");
-				node_malformed_error(child, "union field");
-				return -1;
-			}
-			if (!strcmp(ts_node_type(field_type), "primitive_type")) {
-				// 2nd case, atomic field
-				// AST looks like
-				// type: (primitive_type) declarator: (field_identifier)
-				const char *real_type = ts_node_sub_string(field_type, text);
-				if (!real_type) {
-					eprintf("ERROR: union field type should not be NULL!\n");
-					node_malformed_error(child, "union field");
-					return -1;
-				}
-				const char *real_identifier = ts_node_sub_string(field_identifier, text);
-				if (!real_identifier) {
-					eprintf("ERROR: union bitfield identifier should not be NULL!\n");
-					node_malformed_error(child, "union field");
-					return -1;
-				}
-				eprintf("field type: %s field_identifier: %s\n", real_type, real_identifier);
-				parse_identifier_node(state, field_identifier, text);
-			} else {
-				// 3rd case, complex type
-				// AST looks like
-				// type: (union_specifier ...) declarator: (field_identifier)
-			}
+		// Every field can be:
+		// - atomic: "int a;" or "char b[20]"
+		// - bitfield: "int a:7;"
+		// - nested: "struct { ... } a;" or "union { ... } a;"
+		// - anonymous nested: "struct { ... };" or "union { ... };"
+		if (parse_field_declaration(state, type, child, text, "union field")) {
+			goto error;
 		}
 	}
+	type = c_parser_store_type(state, type);
+	if (!type) {
+		return -1;
+	}
+	if (type->anonymous && state->verbose) {
+		printf("anonymous union name: %s\n", type->name);
+	}
+	if (tname) {
+		*tname = c_type_key(type->kind, type->name);
+	}
 	return 0;
+error:
+	c_type_free(type);
+	return -1;
 }
 
 // Parsing enum
-int parse_enum_node(CParserState *state, TSNode enumnode, const char *text) {
+int parse_enum_node(CParserState *state, TSNode enumnode, const char *text, char **tname) {
 	rz_return_val_if_fail(!ts_node_is_null(enumnode), -1);
 	rz_return_val_if_fail(ts_node_is_named(enumnode), -1);
 	int enum_node_child_count = ts_node_named_child_count(enumnode);
 	if (enum_node_child_count < 1 || enum_node_child_count > 2) {
-		node_malformed_error(enumnode, "enum");
+		node_malformed_error(state, enumnode, "enum");
 		return -1;
 	}
+	char *realname = NULL;
+	TSNode enum_body;
 	if (enum_node_child_count < 2) {
 		// Anonymous or forward declaration enum
 		TSNode child = ts_node_child(enumnode, 1);
 		if (!ts_node_is_null(child) && ts_node_is_named(child)) {
 			const char *node_type = ts_node_type(child);
 			if (!node_type) {
-				node_malformed_error(enumnode, "enum");
+				node_malformed_error(state, enumnode, "enum");
 				return -1;
 			}
 			// "enum bla;"
 			if (!strcmp(node_type, "type_identifier")) {
 				// We really skip such declarations since they don't
-				// make sense for our goal
+				// make sense for our goal, but the name is still
+				// needed for the references like "enum bla e;"
+				if (tname) {
+					char *name = scoped_name(state, ts_node_sub_string(child, text));
+					*tname = c_type_key(C_TYPE_KIND_ENUM, name);
+					free(name);
+				}
+				return 0;
 			// Anonymous enum, "enum { A = 1, B = 2 };"
 			} else if (!strcmp(node_type, "enumerator_list")) {
-				// FIXME: Handle anonymous enums
-				eprintf("Anonymous enums aren't supported yet!\n");
-				return -1;
+				enum_body = child;
 			} else {
-				node_malformed_error(enumnode, "enum");
+				node_malformed_error(state, enumnode, "enum");
 				return -1;
 			}
 		} else {
-			node_malformed_error(enumnode, "enum");
+			node_malformed_error(state, enumnode, "enum");
+			return -1;
+		}
+	} else {
+		TSNode enum_name = ts_node_named_child(enumnode, 0);
+		enum_body = ts_node_named_child(enumnode, 1);
+		if (ts_node_is_null(enum_name) || ts_node_is_null(enum_body)) {
+			eprintf("ERROR: Enum name and body nodes should not be NULL!\n");
+			node_malformed_error(state, enumnode, "enum");
 			return -1;
 		}
+		realname = scoped_name(state, ts_node_sub_string(enum_name, text));
+		if (!realname) {
+			eprintf("ERROR: Enum name should not be NULL!\n");
+			node_malformed_error(state, enumnode, "enum");
+			return -1;
+		}
+		if (state->verbose) {
+			printf("enum name: %s\n", realname);
+		}
 	}
-	TSNode enum_name = ts_node_named_child(enumnode, 0);
-	TSNode enum_body = ts_node_named_child(enumnode, 1);
-	if (ts_node_is_null(enum_name) || ts_node_is_null(enum_body)) {
-		eprintf("ERROR: Enum name and body nodes should not be NULL!\n");
-		node_malformed_error(enumnode, "enum");
+	int body_child_count = ts_node_named_child_count(enum_body);
+	if (!body_child_count) {
+		eprintf("ERROR: Enum body should not be empty!\n");
+		node_malformed_error(state, enumnode, "enum");
+		free(realname);
 		return -1;
 	}
-	int body_child_count = ts_node_named_child_count(enum_body);
-	const char *realname = ts_node_sub_string(enum_name, text);
-	if (!realname || !body_child_count) {
-		eprintf("ERROR: Enum name should not be NULL!\n");
-		node_malformed_error(enumnode, "enum");
+	CType *type = c_type_new(C_TYPE_KIND_ENUM, realname);
+	free(realname);
+	if (!type) {
 		return -1;
 	}
-	printf("enum name: %s\n", realname);
 	int i;
 	for (i = 0; i < body_child_count; i++) {
 		if (state->verbose) {
 			printf("enum: processing %d field...\n", i);
 		}
+		// Partially parsed enum is dropped when the budget expires
+		if (c_parser_should_stop(state)) {
+			goto error;
+		}
 		TSNode child = ts_node_named_child(enum_body, i);
+		state->stats.nodes++;
 		const char *node_type = ts_node_type(child);
 		// Every field should have (field_declaration) AST clause
 		if (strcmp(node_type, "enumerator")) {
 			eprintf("ERROR: Enum member AST should contain (enumerator) node!\n");
-			node_malformed_error(child, "enum field");
-			return -1;
+			node_malformed_error(state, child, "enum field");
+			goto error;
 		}
 		// Every member node should have at least 1 child!
 		int member_child_count = ts_node_named_child_count(child);
 		if (member_child_count < 1 || member_child_count > 2) {
 			eprintf("ERROR: enum member AST cannot contain less than 1 or more than 2 items");
-			node_malformed_error(child, "enum field");
-			return -1;
+			node_malformed_error(state, child, "enum field");
+			goto error;
 		}
 		// Every member can be:
 		// - empty
 		// - atomic: "1"
 		// - expression: "1 << 2"
 		if (state->verbose) {
-			const char *membertext = ts_node_sub_string(child, text);
+			char *membertext = ts_node_sub_string(child, text);
 			char *nodeast = ts_node_string(child);
 			if (membertext && nodeast) {
 				printf("member text: %s\n", membertext);
 				printf("member ast: %s\n", nodeast);
 			}
+			free(membertext);
 			free(nodeast);
 		}
+		CTypeMember member = { 0 };
 		if (member_child_count == 1) {
 			// It's an empty field, like just "A,"
 			TSNode member_identifier = ts_node_named_child(child, 0);
 			if (ts_node_is_null(member_identifier)) {
 				eprintf("ERROR: Enum member identifier should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
+				node_malformed_error(state, child, "struct field");
+				goto error;
+			}
+			member.name = ts_node_sub_string(member_identifier, text);
+			if (state->verbose) {
+				printf("enum member: %s\n", member.name);
 			}
-			const char *real_identifier = ts_node_sub_string(member_identifier, text);
-			printf("enum member: %s\n", real_identifier);
 		} else {
 			// It's a proper field, like "A = 1,"
 			TSNode member_identifier = ts_node_named_child(child, 0);
 			TSNode member_value = ts_node_named_child(child, 1);
 			if (ts_node_is_null(member_identifier) || ts_node_is_null(member_value)) {
 				eprintf("ERROR: Enum member identifier and value should not be NULL!\n");
-				node_malformed_error(child, "struct field");
-				return -1;
+				node_malformed_error(state, child, "struct field");
+				goto error;
+			}
+			member.name = ts_node_sub_string(member_identifier, text);
+			member.value = ts_node_sub_string(member_value, text);
+			// Evaluated once the enum is stored, see c_parser_enum_index()
+			if (state->verbose) {
+				printf("enum member: %s value: %s\n", member.name, member.value);
 			}
-			const char *real_identifier = ts_node_sub_string(member_identifier, text);
-			const char *real_value = ts_node_sub_string(member_value, text);
-			// FIXME: Use RzNum to calculate complex expressions
-			printf("enum member: %s value: %s\n", real_identifier, real_value);
 		}
+		rz_vector_push(&type->members, &member);
+	}
+	type = c_parser_store_type(state, type);
+	if (!type) {
+		return -1;
+	}
+	if (type->anonymous && state->verbose) {
+		printf("anonymous enum name: %s\n", type->name);
+	}
+	if (tname) {
+		*tname = c_type_key(type->kind, type->name);
 	}
 	return 0;
+error:
+	c_type_free(type);
+	return -1;
+}
+
+// Typedef alias can be simple or pointers or arrays
+// e.g. "typedef int *intptr;" or "typedef char buf[16];"
+static char *parse_typedef_alias(CParserState *state, TSNode aliasnode, const char *text, CTypeMember *member) {
+	TSNode node = aliasnode;
+	while (!ts_node_is_null(node)) {
+		const char *node_type = ts_node_type(node);
+		if (!strcmp(node_type, "type_identifier")) {
+			return ts_node_sub_string(node, text);
+		} else if (!strcmp(node_type, "pointer_declarator")) {
+			// Qualifiers precede the declarator, e.g. "typedef char *const cstr;"
+			member->pointers++;
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else if (!strcmp(node_type, "array_declarator")) {
+			TSNode size_node = ts_node_child_by_field_name(node, "size", strlen("size"));
+			if (ts_node_is_null(size_node)) {
+				break;
+			}
+			char *array_size = ts_node_sub_string(size_node, text);
+			member->array = array_size ? atoi(array_size) : 0;
+			free(array_size);
+			node = ts_node_child_by_field_name(node, "declarator", strlen("declarator"));
+		} else {
+			// Function types are not supported yet
+			break;
+		}
+	}
+	return NULL;
 }
 
 // Parsing typedefs
@@ -579,20 +1260,20 @@ int parse_typedef_node(CParserState *state, TSNode typedefnode, const char *text
 	rz_return_val_if_fail(ts_node_is_named(typedefnode), -1);
 	int typedef_node_child_count = ts_node_named_child_count(typedefnode);
 	if (typedef_node_child_count != 2) {
-		node_malformed_error(typedefnode, "typedef");
+		node_malformed_error(state, typedefnode, "typedef");
 		return -1;
 	}
 	TSNode typedef_type = ts_node_named_child(typedefnode, 0);
 	TSNode typedef_alias = ts_node_named_child(typedefnode, 1);
 	if (ts_node_is_null(typedef_type) || ts_node_is_null(typedef_alias)) {
 		eprintf("ERROR: Typedef type and alias nodes should not be NULL!\n");
-		node_malformed_error(typedefnode, "typedef");
+		node_malformed_error(state, typedefnode, "typedef");
 		return -1;
 	}
-	const char *aliasname = ts_node_sub_string(typedef_alias, text);
+	char *aliasname = ts_node_sub_string(typedef_alias, text);
 	if (!aliasname) {
 		eprintf("ERROR: Typedef alias name should not be NULL!\n");
-		node_malformed_error(typedefnode, "typedef");
+		node_malformed_error(state, typedefnode, "typedef");
 		return -1;
 	}
 	// Every typedef type can be:
@@ -600,31 +1281,85 @@ int parse_typedef_node(CParserState *state, TSNode typedefnode, const char *text
 	// - some type name - any identificator
 	// - complex type like struct, union, or enum
 	if (state->verbose) {
-		const char *typetext = ts_node_sub_string(typedef_type, text);
+		char *typetext = ts_node_sub_string(typedef_type, text);
 		char *nodeast = ts_node_string(typedef_type);
 		if (typetext && nodeast) {
 			printf("type text: %s\n", typetext);
 			printf("type ast: %s\n", nodeast);
 		}
+		free(typetext);
 		free(nodeast);
 	}
+	char *real_type = NULL;
 	int type_child_count = ts_node_named_child_count(typedef_type);
 	if (!type_child_count) {
 		const char *node_type = ts_node_type(typedef_type);
 		if (!strcmp(node_type, "primitive_type")) {
-			const char *real_type = ts_node_sub_string(typedef_type, text);
-			eprintf("typedef type: %s alias: %s\n", real_type, aliasname);
+			real_type = ts_node_sub_string(typedef_type, text);
+			if (state->verbose) {
+				eprintf("typedef type: %s alias: %s\n", real_type, aliasname);
+			}
 		} else if (!strcmp(node_type, "type_identifier")) {
-			const char *real_type = ts_node_sub_string(typedef_type, text);
-			eprintf("typedef type: %s alias: %s\n", real_type, aliasname);
+			real_type = ts_node_sub_string(typedef_type, text);
+			if (state->verbose) {
+				eprintf("typedef type: %s alias: %s\n", real_type, aliasname);
+			}
 		} else {
 			eprintf("ERROR: Typedef type AST should contain (primitive_type) or (identifier) node!\n");
-			node_malformed_error(typedef_type, "typedef type");
+			node_malformed_error(state, typedef_type, "typedef type");
+			free(aliasname);
 			return -1;
 		}
 	} else {
-		const char *real_type = ts_node_sub_string(typedef_type, text);
-		eprintf("complex typedef type: %s alias: %s\n", real_type, aliasname);
+		// Complex type, e.g. "typedef struct { ... } A;"
+		real_type = parse_field_type(state, typedef_type, text);
+		if (!real_type) {
+			node_malformed_error(state, typedef_type, "typedef type");
+			free(aliasname);
+			return -1;
+		}
+		if (state->verbose) {
+			eprintf("complex typedef type: %s alias: %s\n", real_type, aliasname);
+		}
+	}
+	free(aliasname);
+	if (!real_type) {
+		return -1;
+	}
+	// Typedef is stored with a single member describing the aliased type
+	CTypeMember member = { 0 };
+	char *name = NULL;
+	if (declarator_is_function(state, typedef_alias, text)) {
+		// e.g. "typedef char *(*FcnPtr)(int a);"
+		member.type = real_type;
+		if (parse_function_member(state, typedef_alias, text, &member)) {
+			free(member.type);
+			return -1;
+		}
+		name = scoped_name(state, member.name);
+		member.name = NULL;
+	} else {
+		name = scoped_name(state, parse_typedef_alias(state, typedef_alias, text, &member));
+		if (!name) {
+			node_malformed_error(state, typedef_alias, "typedef alias");
+			free(real_type);
+			return -1;
+		}
+		member.type = real_type;
+	}
+	CType *type = c_type_new(C_TYPE_KIND_TYPEDEF, name);
+	free(name);
+	if (!type) {
+		free(real_type);
+		return -1;
+	}
+	rz_vector_push(&type->members, &member);
+	type = c_parser_store_type(state, type);
+	if (!type) {
+		return -1;
+	}
+	if (state->verbose) {
+		printf("typedef %s canonical type: %s\n", type->name, c_parser_canonical_type(state, type->name));
 	}
 	return 0;
 }
@@ -633,7 +1368,326 @@ int parse_type_tree(CParserState *state, TSNode typenode, const char *text) {
 	rz_return_val_if_fail(!ts_node_is_null(typenode), -1);
 	rz_return_val_if_fail(ts_node_is_named(typenode), -1);
 	const char *node_type = ts_node_type(typenode);
-	printf("Node type is %s\n", node_type);
+	if (state->verbose) {
+		printf("Node type is %s\n", node_type);
+	}
+	return 0;
+}
+
+// C++ classes, namespaces and templates
+
+static bool node_has_child_type(TSNode node, const char *needle) {
+	int i, count = ts_node_child_count(node);
+	for (i = 0; i < count; i++) {
+		if (strstr(ts_node_type(ts_node_child(node, i)), needle)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool is_class_declarator(const char *node_type) {
+	return !strcmp(node_type, "field_identifier") || strstr(node_type, "declarator");
+}
+
+// Data member of a class, static members and methods take no space
+// in the object thus are skipped. References are laid out as pointers
+static int parse_class_field(CParserState *state, CType *type, TSNode field, const char *text, bool *virtual) {
+	if (node_has_child_type(field, "virtual")) {
+		*virtual = true;
+	}
+	int i, count = ts_node_named_child_count(field);
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(field, i);
+		if (!strcmp(ts_node_type(child), "storage_class_specifier")) {
+			char *storage = ts_node_sub_string(child, text);
+			bool is_static = storage && !strcmp(storage, "static");
+			free(storage);
+			if (is_static) {
+				return 0;
+			}
+		}
+	}
+	TSNode typenode = ts_node_child_by_field_name(field, "type", strlen("type"));
+	if (ts_node_is_null(typenode)) {
+		// e.g. constructors and destructors
+		return 0;
+	}
+	char *base = parse_declaration_type(state, field, text);
+	if (!base) {
+		node_malformed_error(state, field, "class field");
+		return -1;
+	}
+	int declarators = 0;
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(field, i);
+		const char *node_type = ts_node_type(child);
+		if (!is_class_declarator(node_type)) {
+			continue;
+		}
+		declarators++;
+		CTypeMember member = { 0 };
+		member.type = strdup(base);
+		int result = 0;
+		if (declarator_is_function(state, child, text)) {
+			CDeclarator decl = { 0 };
+			parse_declarator_chain(state, child, text, &decl);
+			free(decl.name);
+			if (!decl.fn_pointers) {
+				// Method
+				if (node_has_child_type(child, "virtual")) {
+					*virtual = true;
+				}
+				free(member.type);
+				continue;
+			}
+			result = parse_function_member(state, child, text, &member);
+		} else if (!strcmp(node_type, "reference_declarator")) {
+			TSNode inner = ts_node_named_child(child, 0);
+			if (ts_node_is_null(inner)) {
+				node_malformed_error(state, child, "class field");
+				result = -1;
+			} else {
+				result = parse_field_declarator(state, inner, text, &member);
+				member.pointers++;
+			}
+		} else {
+			result = parse_field_declarator(state, child, text, &member);
+		}
+		if (result) {
+			// Reported along the way, only the member is skipped
+			free(member.type);
+			continue;
+		}
+		// "int a : 3;"
+		TSNode next = ts_node_next_named_sibling(child);
+		if (!ts_node_is_null(next) && !strcmp(ts_node_type(next), "bitfield_clause")) {
+			char *bits = ts_node_sub_string(ts_node_named_child(next, 0), text);
+			member.bits = bits ? atoi(bits) : 0;
+			free(bits);
+		}
+		rz_vector_push(&type->members, &member);
+	}
+	// Anonymous struct or union member, while the named nested
+	// types without a declarator are only the definitions
+	if (!declarators && ts_node_is_null(ts_node_child_by_field_name(typenode, "name", strlen("name")))
+		&& !ts_node_is_null(ts_node_child_by_field_name(typenode, "body", strlen("body")))) {
+		CTypeMember member = { .type = base };
+		rz_vector_push(&type->members, &member);
+		return 0;
+	}
+	free(base);
+	return 0;
+}
+
+// Class or C++ struct, stored as a struct with the members in the
+// declaration order: the non-virtual bases first, as the anonymous
+// members, and the hidden vtable pointer of the dynamic classes
+// without bases. Every named class is also a type name in C++, so
+// an alias is stored as well, e.g. "A" for "struct A"
+int parse_class_node(CParserState *state, TSNode classnode, const char *text, char **tname) {
+	rz_return_val_if_fail(!ts_node_is_null(classnode), -1);
+	TSNode name_node = ts_node_child_by_field_name(classnode, "name", strlen("name"));
+	TSNode body = ts_node_child_by_field_name(classnode, "body", strlen("body"));
+	char *raw_name = ts_node_is_null(name_node) ? NULL : ts_node_sub_string(name_node, text);
+	char *name = raw_name ? scoped_name(state, strdup(raw_name)) : NULL;
+	if (ts_node_is_null(body)) {
+		// "class A;" or a reference like "class A *p;"
+		if (!name) {
+			node_malformed_error(state, classnode, "class");
+			return -1;
+		}
+		if (tname) {
+			*tname = c_type_key(C_TYPE_KIND_STRUCT, name);
+		} else {
+			CType *type = c_type_new(C_TYPE_KIND_STRUCT, name);
+			if (type) {
+				type->forward = true;
+				c_parser_store_type(state, type);
+			}
+		}
+		free(raw_name);
+		free(name);
+		return 0;
+	}
+	CType *type = c_type_new(C_TYPE_KIND_STRUCT, name);
+	free(name);
+	if (!type) {
+		free(raw_name);
+		return -1;
+	}
+	type->templated = state->templates > 0;
+	int i, count = ts_node_named_child_count(classnode);
+	bool bases = false;
+	for (i = 0; i < count; i++) {
+		TSNode clause = ts_node_named_child(classnode, i);
+		if (strcmp(ts_node_type(clause), "base_class_clause")) {
+			continue;
+		}
+		int j, bases_count = ts_node_named_child_count(clause);
+		for (j = 0; j < bases_count; j++) {
+			TSNode base = ts_node_named_child(clause, j);
+			const char *node_type = ts_node_type(base);
+			if (strcmp(node_type, "type_identifier") && strcmp(node_type, "qualified_identifier")
+				&& strcmp(node_type, "template_type")) {
+				continue;
+			}
+			CTypeMember member = { .type = ts_node_sub_string(base, text) };
+			rz_vector_push(&type->members, &member);
+			bases = true;
+		}
+	}
+	// Nested types are qualified by the class name
+	char *saved = raw_name ? scope_push(state, raw_name) : NULL;
+	bool virtual = false;
+	int result = 0;
+	count = ts_node_named_child_count(body);
+	for (i = 0; i < count && !result; i++) {
+		if (c_parser_should_stop(state)) {
+			result = -1;
+			break;
+		}
+		TSNode child = ts_node_named_child(body, i);
+		state->stats.nodes++;
+		const char *node_type = ts_node_type(child);
+		if (!strcmp(node_type, "field_declaration")) {
+			result = parse_class_field(state, type, child, text, &virtual);
+		} else if (!strcmp(node_type, "type_definition") || !strcmp(node_type, "alias_declaration")
+			|| !strcmp(node_type, "template_declaration")) {
+			// Nested types
+			filter_type_nodes(state, child, text);
+		} else if ((!strcmp(node_type, "function_definition") || !strcmp(node_type, "declaration"))
+			&& node_has_child_type(child, "virtual")) {
+			virtual = true;
+		}
+		// Access specifiers, methods, friends and using declarations
+		// don't change the layout
+	}
+	if (raw_name) {
+		scope_pop(state, saved);
+		free(raw_name);
+	}
+	if (result) {
+		c_type_free(type);
+		return -1;
+	}
+	if (virtual && !bases) {
+		CTypeMember vptr = { .name = strdup("__vptr"), .type = strdup("void"), .pointers = 1 };
+		rz_vector_insert(&type->members, 0, &vptr);
+	}
+	type = c_parser_store_type(state, type);
+	if (!type) {
+		return -1;
+	}
+	char *key = c_type_key(type->kind, type->name);
+	if (!key) {
+		return -1;
+	}
+	if (!type->anonymous) {
+		CType *alias = c_type_new(C_TYPE_KIND_TYPEDEF, type->name);
+		CTypeMember member = { .type = strdup(key) };
+		if (alias) {
+			alias->templated = type->templated;
+			rz_vector_push(&alias->members, &member);
+			c_parser_store_type(state, alias);
+		} else {
+			free(member.type);
+		}
+	}
+	if (tname) {
+		*tname = key;
+	} else {
+		free(key);
+	}
+	return 0;
+}
+
+// "namespace a { ... }", the nested names are qualified with "a::"
+static int parse_namespace_node(CParserState *state, TSNode nsnode, const char *text) {
+	TSNode name_node = ts_node_child_by_field_name(nsnode, "name", strlen("name"));
+	TSNode body = ts_node_child_by_field_name(nsnode, "body", strlen("body"));
+	if (ts_node_is_null(body)) {
+		node_malformed_error(state, nsnode, "namespace");
+		return -1;
+	}
+	char *name = ts_node_is_null(name_node) ? NULL : ts_node_sub_string(name_node, text);
+	// Anonymous namespace members are accessed unqualified
+	char *saved = name ? scope_push(state, name) : NULL;
+	int i, count = ts_node_named_child_count(body);
+	for (i = 0; i < count; i++) {
+		if (c_parser_should_stop(state)) {
+			break;
+		}
+		filter_type_nodes(state, ts_node_named_child(body, i), text);
+	}
+	if (name) {
+		scope_pop(state, saved);
+		free(name);
+	}
+	return 0;
+}
+
+// Only the declared entity is extracted, the class templates are stored
+// as the patterns, since laying them out needs the template arguments
+static int parse_template_node(CParserState *state, TSNode templatenode, const char *text) {
+	int i, count = ts_node_named_child_count(templatenode);
+	state->templates++;
+	for (i = 0; i < count; i++) {
+		TSNode child = ts_node_named_child(templatenode, i);
+		if (strcmp(ts_node_type(child), "template_parameter_list")) {
+			filter_type_nodes(state, child, text);
+		}
+	}
+	state->templates--;
+	return 0;
+}
+
+// "using A = int *;" is the same as the typedef
+static int parse_alias_node(CParserState *state, TSNode aliasnode, const char *text) {
+	TSNode name_node = ts_node_child_by_field_name(aliasnode, "name", strlen("name"));
+	TSNode descriptor = ts_node_child_by_field_name(aliasnode, "type", strlen("type"));
+	if (ts_node_is_null(name_node) || ts_node_is_null(descriptor)) {
+		node_malformed_error(state, aliasnode, "alias");
+		return -1;
+	}
+	CTypeMember member = { 0 };
+	member.type = parse_declaration_type(state, descriptor, text);
+	CDeclarator decl = { 0 };
+	TSNode declnode = ts_node_child_by_field_name(descriptor, "declarator", strlen("declarator"));
+	if (!member.type || !parse_declarator_chain(state, declnode, text, &decl) || !ts_node_is_null(decl.function)) {
+		// Function types are not supported in the aliases yet
+		free(member.type);
+		free(decl.name);
+		return ts_node_is_null(decl.function) ? -1 : 0;
+	}
+	free(decl.name);
+	member.pointers = decl.pointers;
+	char *name = scoped_name(state, ts_node_sub_string(name_node, text));
+	CType *type = name ? c_type_new(C_TYPE_KIND_TYPEDEF, name) : NULL;
+	free(name);
+	if (!type) {
+		free(member.type);
+		return -1;
+	}
+	type->templated = state->templates > 0;
+	rz_vector_push(&type->members, &member);
+	return c_parser_store_type(state, type) ? 0 : -1;
+}
+
+// extern "C" { ... } or extern "C" int f(void);
+static int parse_linkage_node(CParserState *state, TSNode linkagenode, const char *text) {
+	TSNode body = ts_node_child_by_field_name(linkagenode, "body", strlen("body"));
+	if (ts_node_is_null(body)) {
+		node_malformed_error(state, linkagenode, "linkage specification");
+		return -1;
+	}
+	if (strcmp(ts_node_type(body), "declaration_list")) {
+		return filter_type_nodes(state, body, text);
+	}
+	int i, count = ts_node_named_child_count(body);
+	for (i = 0; i < count && !c_parser_should_stop(state); i++) {
+		filter_type_nodes(state, ts_node_named_child(body, i), text);
+	}
 	return 0;
 }
 
@@ -643,28 +1697,43 @@ int parse_type_tree(CParserState *state, TSNode typenode, const char *text) {
 // - enum (enum_specifier) (usually prepended by declaration)
 // - typedef (type_definition)
 // - atomic type
+// - function prototype (declaration)
+// - C++ class, namespace, template or alias, only with the C++ grammar
 int filter_type_nodes(CParserState *state, TSNode node, const char *text) {
 	rz_return_val_if_fail(!ts_node_is_null(node), -1);
 	// We skip simple nodes (e.g. conditions and braces)
 	if (!ts_node_is_named(node)) {
 		return 0;
 	}
+	if (c_parser_should_stop(state)) {
+		return -1;
+	}
+	state->stats.nodes++;
 	const char *node_type = ts_node_type(node);
 	int result = -1;
-	if (!strcmp(node_type, "struct_specifier")) {
-		result = parse_struct_node(state, node, text);
+	if (!strcmp(node_type, "struct_specifier") && state->lang == C_PARSER_LANG_CPP) {
+		// C++ structs can have bases and methods
+		result = parse_class_node(state, node, text, NULL);
+	} else if (!strcmp(node_type, "struct_specifier")) {
+		result = parse_struct_node(state, node, text, NULL);
 	} else if (!strcmp(node_type, "union_specifier")) {
-		result = parse_union_node(state, node, text);
+		result = parse_union_node(state, node, text, NULL);
 	} else if (!strcmp(node_type, "enum_specifier")) {
-		result = parse_enum_node(state, node, text);
+		result = parse_enum_node(state, node, text, NULL);
 	} else if (!strcmp(node_type, "type_definition")) {
 		result = parse_typedef_node(state, node, text);
+	} else if (!strcmp(node_type, "declaration") || !strcmp(node_type, "function_definition")) {
+		result = parse_declaration_node(state, node, text);
+	} else if (!strcmp(node_type, "class_specifier")) {
+		result = parse_class_node(state, node, text, NULL);
+	} else if (!strcmp(node_type, "namespace_definition")) {
+		result = parse_namespace_node(state, node, text);
+	} else if (!strcmp(node_type, "template_declaration")) {
+		result = parse_template_node(state, node, text);
+	} else if (!strcmp(node_type, "alias_declaration")) {
+		result = parse_alias_node(state, node, text);
+	} else if (!strcmp(node_type, "linkage_specification")) {
+		result = parse_linkage_node(state, node, text);
 	}
-
-	// Another case where there is a declaration clause
-	// In this case we should drop the declaration itself
-	// and parse only the corresponding type
-	// In case of anonymous type we could use identifier as a name for this type?
-	//
 	return result;
 }
@@ -1,9 +1,316 @@
+#ifndef TYPES_PARSER_H
+#define TYPES_PARSER_H
+
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_util/ht_pp.h>
+#include <rz_util/ht_up.h>
+#include <rz_util/ht_pu.h>
+#include <tree_sitter/api.h>
+
+#include <line_index.h>
+#include <ts_alloc.h>
+#include <types_intern.h>
+
+typedef enum {
+	C_TYPE_KIND_STRUCT = 0,
+	C_TYPE_KIND_UNION,
+	C_TYPE_KIND_ENUM,
+	C_TYPE_KIND_TYPEDEF,
+} CTypeKind;
+
+// Struct/union field or enum member, also the aliased type of a typedef
 typedef struct {
-	bool verbose;
+	char *name;
+	char *type; // Field type, e.g. "int" or "struct S2", NULL for enum members
+	int pointers; // Level of pointer indirection
+	int array; // Number of array elements, 0 if not an array
+	int bits; // Bitfield width, 0 if not a bitfield
+	char *value; // Enum member value expression, NULL if implicit
+	ut32 offset; // Byte offset within the struct, see c_parser_compute_layouts()
+	ut32 bit_offset; // Bit offset within the storage unit of the bitfield
+	ut32 function; // Signature of the function pointer, see CParserState.functions, 0 if none
+} CTypeMember;
+
+// Entry of the flattened member table, see c_parser_member_at()
+typedef struct {
+	ut32 offset; // Byte offset from the start of the outermost type
+	ut32 size; // Size of a single element
+	ut32 count; // Number of array elements, 1 if not an array
+	ut32 end_max; // Maximum end offset of this and all the preceding entries
+	ut32 order; // Declaration order, to keep the union members ordered
+	ut32 bit_offset;
+	int bits;
+	char *path; // e.g. "y.a", nested members are inlined
+	struct c_type_t *elem; // Struct or union of the array elements, resolved by the stride
+} CTypeOffset;
+
+typedef struct {
+	ut64 value;
+	const char *name; // Owned by the enum members
+	ut32 order; // Declaration order, the first declared name wins
+} CEnumValue;
+
+// Value to name lookup of an enum, see c_parser_enum_index()
+typedef struct {
+	RzVector /*<CEnumValue>*/ values; // Sorted by value
+	const char **dense; // Names by value - dense_base, NULL if the range is sparse
+	ut64 dense_base;
+	ut32 dense_count;
+	const char *bits[64]; // Single bit enumerators by the bit number
+	ut32 bits_order[64];
+	ut32 unresolved; // Values which cannot be evaluated, taken as 0
+} CEnumIndex;
+
+typedef struct c_type_t {
+	CTypeKind kind;
+	char *name;
+	bool anonymous; // Name is derived from the structural hash
+	bool forward; // Only declared so far, e.g. "struct bla;"
+	bool templated; // C++ class template, not laid out until instantiated
+	ut64 hash; // Structural hash, see c_type_hash()
+	RzVector /*<CTypeMember>*/ members;
+	struct c_type_t *canonical; // First stored type of the same shape, may be itself
+	struct c_type_t *parent; // Typedef union-find parent, see c_parser_resolve_typedef()
+	ut32 mark; // Cycle detection during the typedef resolution
+	ut32 index; // Position in the dependency graph
+	ut32 layout_epoch; // Layout pass the type takes part in, see CParserState.layout_epoch
+	bool laid_out; // Size and alignment are computed
+	bool invalid; // Waits in CParserState.invalid to be laid out again
+	ut32 size;
+	ut32 align;
+	RzVector /*<CTypeOffset>*/ offsets; // Flattened members sorted by offset
+	CEnumIndex *enum_index; // Built on demand
+	ut32 origin; // Worker the type was parsed by in the parallel mode, see c_parser_merge_functions()
+} CType;
+
+// Edge of the dependency index, see c_parser_type_dependents()
+typedef struct {
+	CType *type; // Type with the members referring to the name
+	bool by_value; // Some member embeds it, otherwise only pointers refer to it
+} CTypeDep;
+
+typedef enum {
+	C_PARSER_LANG_C = 0,
+	C_PARSER_LANG_CPP,
+} CParserLang;
+
+typedef enum {
+	C_CALLCONV_DEFAULT = 0,
+	C_CALLCONV_CDECL,
+	C_CALLCONV_STDCALL,
+	C_CALLCONV_FASTCALL,
+	C_CALLCONV_THISCALL,
+	C_CALLCONV_VECTORCALL,
+	C_CALLCONV_MS_ABI,
+	C_CALLCONV_SYSV_ABI,
+} CCallConv;
+
+// Function prototype or function pointer type. Parameters are a range
+// of the shared parameter arrays, so the table is scanned without
+// chasing per-function allocations
+typedef struct {
+	ut32 name; // Interned name, 0 for the function pointer types
+	ut32 type; // Type id of the signature itself, e.g. "int (int, char *)"
+	ut32 ret; // Type id of the return type
+	ut32 params; // Index of the first parameter in CParserState.param_types
+	ut32 params_count;
+	bool variadic;
+	ut8 callconv; // CCallConv
+} CFunction;
+
+enum {
+	C_STORAGE_EXTERN = 1 << 0,
+	C_STORAGE_STATIC = 1 << 1,
+	C_STORAGE_THREAD_LOCAL = 1 << 2,
+};
+
+// Global object declaration, e.g. "extern const char *names[4];"
+typedef struct {
+	ut32 name; // Interned, qualified by the C++ namespaces
+	ut32 type; // Type id of the whole type, e.g. "const char *[4]"
+	ut32 base; // Type id of the base type, e.g. "const char"
+	int pointers;
+	int array; // Number of elements, 0 if not an array or unknown
+	ut32 function; // Signature of the function pointer, 0 if none
+	ut8 storage; // C_STORAGE_* flags
+	bool defined; // Seen without "extern"
+} CGlobal;
+
+typedef enum {
+	C_PARSER_PHASE_READ = 0,
+	C_PARSER_PHASE_PARSE,
+	C_PARSER_PHASE_WALK,
+	C_PARSER_PHASE_EMIT,
+	C_PARSER_PHASE_COUNT,
+} CParserPhase;
 
+typedef struct {
+	ut64 phase_time[C_PARSER_PHASE_COUNT]; // Microseconds spent in every phase
+	ut64 phase_start[C_PARSER_PHASE_COUNT];
+	ut64 phase_rss[C_PARSER_PHASE_COUNT]; // Peak RSS in bytes by the end of every phase
+	ut64 files;
+	ut64 bytes; // Input bytes read
+	ut64 nodes; // AST nodes visited by the walkers
+	ut64 types; // Types extracted into the storage
+	ut64 fields; // Struct/union fields and enum members of the extracted types
+	ut64 malformed; // Malformed AST nodes
+	ut64 budgets_expired; // Inputs not fully processed within the time budget
+	ut64 stored_blocks; // Heap blocks of the stored types, estimated from their contents
+	ut64 stored_bytes; // Bytes of the stored types, estimated from their contents
+	ut64 instructions; // Instructions retired, 0 if the counter is not available
+	CTsAllocStats ts_alloc; // Pools of the parallel workers, see c_ts_alloc_stats()
+	int perf_fd;
+} CParserStats;
+
+typedef enum {
+	C_PARSER_DIAG_MALFORMED = 0, // Unexpected AST shape
+} CParserDiagCode;
+
+// Compact record of a problem, rendered only on demand
+typedef struct {
+	CParserDiagCode code;
+	TSSymbol symbol;
+	ut32 start; // Byte range of the offending node
+	ut32 end;
+	const char *what; // Static description, e.g. "struct field"
+} CParserDiag;
+
+#define C_PARSER_DIAGS_MAX 1024
+#define C_PARSER_DIAG_EXCERPT 80
+
+typedef struct {
+	bool verbose;
+	CParserStats stats;
+	const TSLanguage *language;
+	CParserLang lang; // Grammar of the current input
+	char *scope; // Enclosing C++ namespaces and classes, e.g. "a::b::", NULL at the top level
+	ut32 templates; // Depth of the enclosing C++ template declarations
+	RzVector /*<CParserDiag>*/ diags; // Diagnostics of the current input, at most C_PARSER_DIAGS_MAX
+	ut64 diags_dropped; // Diagnostics not recorded because of the limit
+	CLineIndex lines; // Line starts of the current input, built on demand
+	HtPP /*<char *, CType *>*/ *types; // Indexed by "struct S1", "union U", "enum E"
+	HtUP /*<ut64, RzList<CType *>>*/ *shapes; // Hash-consing table, indexed by structural hash
+	RzPVector /*<CType *>*/ names; // Stored types sorted by name for the prefix search, owns the types
+	ut32 names_sorted; // Number of sorted entries, the rest is appended since the last query
+	ut64 types_merged; // Identical redefinitions merged into the stored type
+	ut64 types_conflicts; // Different redefinitions under the same name
+	ut64 types_redefined; // Redefinitions which replaced the stored type, see redefine
+	bool redefine; // Newer definitions replace the stored ones, e.g. when a header is imported again
+	HtPP /*<char *, RzVector<CTypeDep>>*/ *dependents; // Types referring to the name, by value or by pointer
+	RzPVector /*<CType *>*/ invalid; // Types to lay out again, see c_parser_update_layouts()
+	bool layouts_computed;
+	ut32 layout_epoch;
+	ut32 resolve_epoch;
+	ut32 pointer_size; // Target pointer size used for the layouts
+	CInterner *interner; // Interned strings, 0 stands for none, shared with the parallel workers
+	CInternCache *intern_cache; // Used by the thread owning the state
+	bool interner_shared; // Owned by another state, see c_parser_state_new_shared()
+	RzVector /*<CFunction>*/ functions; // Index 0 is reserved, ids start from 1
+	RzVector /*<ut32>*/ param_types; // Type ids of the parameters of all the functions
+	RzVector /*<ut32>*/ param_names; // Interned names, parallel to param_types
+	HtPU /*<char *, ut32>*/ *functions_index; // Function ids by name or signature type
+	ut64 functions_merged; // Identical prototypes repeated across the inputs
+	ut64 functions_conflicts; // Different prototypes of the same function
+	RzVector /*<CGlobal>*/ globals;
+	HtPU /*<char *, ut32>*/ *globals_index; // Index in globals by name
+	ut64 globals_conflicts; // Declarations of a different type under the same name
+	size_t cancel; // Cancellation flag, shared with tree-sitter parser
+	ut64 budget; // Time budget for every input in microseconds, 0 if unlimited
+	ut64 deadline; // Monotonic time the current input should be processed by, 0 if unlimited
+	bool timed_out;
+	ut32 stop_checks;
 } CParserState;
 
 CParserState *c_parser_state_new();
+CParserState *c_parser_state_new_shared(CParserState *parent);
 void c_parser_state_free(CParserState *state);
+bool c_parser_take_types(CParserState *state, RzPVector /*<CType *>*/ *out);
 
 int filter_type_nodes(CParserState *state, TSNode node, const char *text);
+
+// Diagnostics
+void c_parser_diag_add(CParserState *state, CParserDiagCode code, TSNode node, const char *what);
+void c_parser_diags_print(CParserState *state, const char *text, size_t len);
+void c_parser_diags_clear(CParserState *state);
+const CLineIndex *c_parser_line_index(CParserState *state, const char *text, size_t len);
+void c_parser_line_index_reset(CParserState *state);
+
+// Time budgets and cancellation
+void c_parser_set_budget(CParserState *state, ut64 budget);
+void c_parser_cancel(CParserState *state);
+bool c_parser_should_stop(CParserState *state);
+
+// Statistics
+void c_parser_stats_start(CParserState *state, CParserPhase phase);
+void c_parser_stats_stop(CParserState *state, CParserPhase phase);
+void c_parser_stats_counters_start(CParserState *state);
+void c_parser_stats_counters_stop(CParserState *state);
+ut64 c_parser_stats_peak_rss(void);
+void c_parser_stats_print(CParserState *state);
+void c_parser_stats_merge(CParserState *state, const CParserState *src);
+
+// Type storage
+CType *c_type_new(CTypeKind kind, const char *name);
+void c_type_free(CType *type);
+char *c_type_key(CTypeKind kind, const char *name);
+ut64 c_type_hash(const CType *type);
+bool c_type_equal(const CType *a, const CType *b);
+CType *c_parser_store_type(CParserState *state, CType *type);
+CType *c_parser_find_type(CParserState *state, const char *name);
+
+// Hash of a type key, e.g. "struct S", for the shared indexes.
+// FNV-1a with a final mix, so every bit depends on the whole key
+static inline ut64 c_type_key_hash(const char *key) {
+	ut64 hash = 0xcbf29ce484222325ULL;
+	const ut8 *p;
+	for (p = (const ut8 *)key; *p; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+RzPVector /*<CType *>*/ *c_parser_complete_type(CParserState *state, const char *prefix);
+CType *c_parser_resolve_typedef(CParserState *state, CType *type);
+const char *c_parser_canonical_type(CParserState *state, const char *name);
+
+// Function signatures
+ut32 c_parser_intern(CParserState *state, const char *str);
+const char *c_parser_atom(CParserState *state, ut32 id);
+ut32 c_parser_store_function(CParserState *state, CFunction *fn, RzVector /*<ut32>*/ *types, RzVector /*<ut32>*/ *names);
+const CFunction *c_parser_function(CParserState *state, ut32 id);
+const CFunction *c_parser_find_function(CParserState *state, const char *name);
+char *c_parser_function_string(CParserState *state, const CFunction *fn);
+ut32 *c_parser_merge_functions(CParserState *state, CParserState *src);
+
+// Global objects
+bool c_parser_store_global(CParserState *state, CGlobal *global);
+const CGlobal *c_parser_find_global(CParserState *state, const char *name);
+bool c_parser_merge_globals(CParserState *state, CParserState *src, const ut32 *functions);
+
+// Type dependencies
+bool c_parser_deps_add(CParserState *state, CType *type);
+void c_parser_deps_remove(CParserState *state, CType *type);
+const RzVector /*<CTypeDep>*/ *c_parser_type_dependents(CParserState *state, const char *name);
+bool c_parser_invalidate_type(CParserState *state, CType *type);
+
+// Type layouts
+int c_parser_compute_layouts(CParserState *state);
+int c_parser_update_layouts(CParserState *state);
+char *c_parser_member_at(CParserState *state, CType *type, ut32 offset);
+
+// Enum value lookup
+void c_enum_index_free(CEnumIndex *index);
+const CEnumIndex *c_parser_enum_index(CParserState *state, CType *type);
+void c_parser_index_enums(CParserState *state);
+const char *c_parser_enum_name(CParserState *state, CType *type, ut64 value);
+char *c_parser_enum_flags(CParserState *state, CType *type, ut64 value);
+
+// Comparison with the rz_type C parser
+int c_parser_compare_rz_type(CParserState *state, int files_count, char **files);
+
+#endif
@@ -15,3 +15,425 @@ int c_parser_new_bitfield(CParserState *state, const char *name) {
 int c_parser_store_bitfield(CParserState *state, const char *name, const char *type, int bits) {
 	return 0;
 }
+
+static void type_member_fini(void *e, void *user) {
+	CTypeMember *member = e;
+	free(member->name);
+	free(member->type);
+	free(member->value);
+}
+
+static void type_offset_fini(void *e, void *user) {
+	CTypeOffset *entry = e;
+	free(entry->path);
+}
+
+CType *c_type_new(CTypeKind kind, const char *name) {
+	CType *type = RZ_NEW0(CType);
+	if (!type) {
+		return NULL;
+	}
+	type->kind = kind;
+	type->name = name ? strdup(name) : NULL;
+	rz_vector_init(&type->members, sizeof(CTypeMember), type_member_fini, NULL);
+	rz_vector_init(&type->offsets, sizeof(CTypeOffset), type_offset_fini, NULL);
+	return type;
+}
+
+void c_type_free(CType *type) {
+	if (!type) {
+		return;
+	}
+	rz_vector_fini(&type->members);
+	rz_vector_fini(&type->offsets);
+	c_enum_index_free(type->enum_index);
+	free(type->name);
+	free(type);
+}
+
+// Returns the name the type is referred by, e.g. "struct S1"
+char *c_type_key(CTypeKind kind, const char *name) {
+	rz_return_val_if_fail(name, NULL);
+	switch (kind) {
+	case C_TYPE_KIND_STRUCT:
+		return rz_str_newf("struct %s", name);
+	case C_TYPE_KIND_UNION:
+		return rz_str_newf("union %s", name);
+	case C_TYPE_KIND_ENUM:
+		return rz_str_newf("enum %s", name);
+	default:
+		return strdup(name);
+	}
+}
+
+// FNV-1a, the separator byte is hashed too, so that
+// "ab" + "c" and "a" + "bc" produce different results
+static ut64 hash_bytes(ut64 hash, const char *str) {
+	const ut8 *p = (const ut8 *)(str ? str : "");
+	for (; *p; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+static ut64 hash_int(ut64 hash, ut64 value) {
+	int i;
+	for (i = 0; i < 8; i++) {
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// Structural hash covers the kind and every member but not the type name,
+// so anonymous types with the same shape end up with the same hash
+ut64 c_type_hash(const CType *type) {
+	rz_return_val_if_fail(type, 0);
+	ut64 hash = 0xcbf29ce484222325ULL;
+	hash = hash_int(hash, type->kind);
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		hash = hash_bytes(hash, member->name);
+		hash = hash_bytes(hash, member->type);
+		hash = hash_bytes(hash, member->value);
+		hash = hash_int(hash, member->pointers);
+		hash = hash_int(hash, member->array);
+		hash = hash_int(hash, member->bits);
+	}
+	return hash;
+}
+
+static bool str_equal(const char *a, const char *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+// Full structural comparison, only needed when the hashes match
+bool c_type_equal(const CType *a, const CType *b) {
+	rz_return_val_if_fail(a && b, false);
+	if (a->kind != b->kind || a->hash != b->hash) {
+		return false;
+	}
+	size_t count = rz_vector_len(&a->members);
+	if (count != rz_vector_len(&b->members)) {
+		return false;
+	}
+	size_t i;
+	for (i = 0; i < count; i++) {
+		CTypeMember *ma = rz_vector_index_ptr((RzVector *)&a->members, i);
+		CTypeMember *mb = rz_vector_index_ptr((RzVector *)&b->members, i);
+		if (!str_equal(ma->name, mb->name)
+				|| !str_equal(ma->type, mb->type)
+				|| !str_equal(ma->value, mb->value)
+				|| ma->pointers != mb->pointers
+				|| ma->array != mb->array
+				|| ma->bits != mb->bits) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Finds the first stored type of the same shape, regardless of the name
+static CType *find_shape(CParserState *state, CType *type) {
+	RzList *bucket = ht_up_find(state->shapes, type->hash, NULL);
+	RzListIter *iter;
+	CType *shape;
+	rz_list_foreach (bucket, iter, shape) {
+		if (c_type_equal(shape, type)) {
+			return shape;
+		}
+	}
+	if (!bucket) {
+		bucket = rz_list_new();
+		if (!bucket) {
+			return NULL;
+		}
+		ht_up_insert(state->shapes, type->hash, bucket);
+	}
+	rz_list_append(bucket, type);
+	return type;
+}
+
+// Drops the type from the bucket of its shape before the shape changes. The
+// types merged into it keep the link, it only tells they were equal once
+static void shape_remove(CParserState *state, CType *type) {
+	RzList *bucket = ht_up_find(state->shapes, type->hash, NULL);
+	if (bucket) {
+		rz_list_delete_data(bucket, type);
+	}
+}
+
+// Moves the definition into the stored record, since the other records
+// and the layouts may already point to it, and queues the layouts
+// depending on the record to be computed again
+static CType *type_replace(CParserState *state, CType *stored, CType *type) {
+	c_parser_deps_remove(state, stored);
+	shape_remove(state, stored);
+	rz_vector_fini(&stored->members);
+	stored->members = type->members;
+	rz_vector_init(&type->members, sizeof(CTypeMember), NULL, NULL);
+	stored->hash = type->hash;
+	stored->forward = false;
+	stored->templated = type->templated;
+	stored->parent = NULL;
+	c_enum_index_free(stored->enum_index);
+	stored->enum_index = NULL;
+	c_type_free(type);
+	stored->canonical = find_shape(state, stored);
+	if (!stored->canonical || !c_parser_deps_add(state, stored) || !c_parser_invalidate_type(state, stored)) {
+		return NULL;
+	}
+	return stored;
+}
+
+// Estimates the memory of the stored type from its contents, without
+// the allocator overhead
+static void type_account(CParserState *state, CType *type) {
+	CParserStats *stats = &state->stats;
+	stats->types++;
+	stats->fields += rz_vector_len(&type->members);
+	stats->stored_blocks += 2;
+	stats->stored_bytes += sizeof(CType) + strlen(type->name) + 1;
+	if (type->members.capacity) {
+		stats->stored_blocks++;
+		stats->stored_bytes += type->members.capacity * sizeof(CTypeMember);
+	}
+	CTypeMember *member;
+	rz_vector_foreach(&type->members, member) {
+		const char *strings[] = { member->name, member->type, member->value };
+		size_t i;
+		for (i = 0; i < RZ_ARRAY_SIZE(strings); i++) {
+			if (strings[i]) {
+				stats->stored_blocks++;
+				stats->stored_bytes += strlen(strings[i]) + 1;
+			}
+		}
+	}
+}
+
+// Takes the ownership of the type and returns the stored record.
+// Anonymous types are named after their structural hash, thus
+// identical anonymous types collapse into a single record.
+// Repeated definitions (e.g. from several copies of the same header)
+// are merged into the first one, while a different definition under
+// the same name is reported as a conflict, or replaces the stored one
+// in the redefine mode. Both checks need only the precomputed hash
+// unless the hashes are equal. Once the layouts are computed, storing
+// a type invalidates the layouts embedding it, see c_parser_update_layouts().
+CType *c_parser_store_type(CParserState *state, CType *type) {
+	rz_return_val_if_fail(state && type, NULL);
+	type->hash = c_type_hash(type);
+	if (!type->name) {
+		type->name = rz_str_newf("anon_%016" PFMT64x, type->hash);
+		type->anonymous = true;
+	}
+	char *key = c_type_key(type->kind, type->name);
+	if (!key) {
+		c_type_free(type);
+		return NULL;
+	}
+	bool found = false;
+	CType *stored = ht_pp_find(state->types, key, &found);
+	if (found && type->forward) {
+		// Declaring an already known type changes nothing
+		c_type_free(type);
+		free(key);
+		return stored;
+	}
+	if (found && stored->forward) {
+		free(key);
+		return type_replace(state, stored, type);
+	}
+	if (found) {
+		if (c_type_equal(stored, type)) {
+			state->types_merged++;
+		} else if (state->redefine) {
+			if (state->verbose) {
+				printf("Redefined %s\n", key);
+			}
+			state->types_redefined++;
+			free(key);
+			return type_replace(state, stored, type);
+		} else {
+			eprintf("ERROR: Conflicting redefinition of %s, keeping the first one\n", key);
+			state->types_conflicts++;
+		}
+		c_type_free(type);
+		free(key);
+		return stored;
+	}
+	// Forward declarations have no shape until completed
+	type->canonical = type->forward ? type : find_shape(state, type);
+	if (!type->canonical) {
+		c_type_free(type);
+		free(key);
+		return NULL;
+	}
+	ht_pp_insert(state->types, key, type);
+	free(key);
+	rz_pvector_push(&state->names, type);
+	type_account(state, type);
+	// A new type may complete the layouts waiting for it
+	if (!c_parser_deps_add(state, type) || !c_parser_invalidate_type(state, type)) {
+		return NULL;
+	}
+	return type;
+}
+
+// O(1) lookup by the full name, e.g. "struct S1" or "jint"
+CType *c_parser_find_type(CParserState *state, const char *name) {
+	rz_return_val_if_fail(state && name, NULL);
+	return ht_pp_find(state->types, name, NULL);
+}
+
+static int type_name_cmp(const void *a, const void *b) {
+	const CType *ta = *(const CType **)a;
+	const CType *tb = *(const CType **)b;
+	int r = strcmp(ta->name, tb->name);
+	return r ? r : (int)ta->kind - (int)tb->kind;
+}
+
+// Types are appended to the name index as they are stored, and the
+// appended tail is sorted and merged only when the index is queried,
+// so a running batch can be queried at any moment
+static bool names_sort(CParserState *state) {
+	ut32 count = rz_pvector_len(&state->names);
+	ut32 sorted = state->names_sorted;
+	if (sorted == count) {
+		return true;
+	}
+	CType **names = (CType **)rz_pvector_data(&state->names);
+	qsort(names + sorted, count - sorted, sizeof(CType *), type_name_cmp);
+	if (sorted) {
+		CType **merged = RZ_NEWS(CType *, count);
+		if (!merged) {
+			return false;
+		}
+		ut32 i = 0, j = sorted, k = 0;
+		while (i < sorted && j < count) {
+			merged[k++] = type_name_cmp(&names[j], &names[i]) < 0 ? names[j++] : names[i++];
+		}
+		while (i < sorted) {
+			merged[k++] = names[i++];
+		}
+		while (j < count) {
+			merged[k++] = names[j++];
+		}
+		memcpy(names, merged, count * sizeof(CType *));
+		free(merged);
+	}
+	state->names_sorted = count;
+	return true;
+}
+
+// Returns the stored types with the name starting with the prefix, in the
+// sorted order. Names are bare, e.g. "S" matches both "struct S1" and "S2"
+RzPVector /*<CType *>*/ *c_parser_complete_type(CParserState *state, const char *prefix) {
+	rz_return_val_if_fail(state && prefix, NULL);
+	if (!names_sort(state)) {
+		return NULL;
+	}
+	RzPVector *result = rz_pvector_new(NULL);
+	if (!result) {
+		return NULL;
+	}
+	CType **names = (CType **)rz_pvector_data(&state->names);
+	size_t prefix_len = strlen(prefix);
+	// Lower bound of the prefix
+	ut32 lo = 0, hi = state->names_sorted;
+	while (lo < hi) {
+		ut32 mid = lo + (hi - lo) / 2;
+		if (strcmp(names[mid]->name, prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for (; lo < state->names_sorted && !strncmp(names[lo]->name, prefix, prefix_len); lo++) {
+		rz_pvector_push(result, names[lo]);
+	}
+	return result;
+}
+
+// Typedef without pointers or arrays is a pure alias of its type
+static bool typedef_is_alias(CType *type) {
+	if (type->kind != C_TYPE_KIND_TYPEDEF || rz_vector_len(&type->members) != 1) {
+		return false;
+	}
+	CTypeMember *member = rz_vector_index_ptr(&type->members, 0);
+	return member->type && !member->pointers && !member->array;
+}
+
+// Returns the typedef record the pure alias refers to, if there is one
+static CType *typedef_target(CParserState *state, CType *type) {
+	if (!typedef_is_alias(type)) {
+		return NULL;
+	}
+	CTypeMember *member = rz_vector_index_ptr(&type->members, 0);
+	CType *target = ht_pp_find(state->types, member->type, NULL);
+	if (!target || target->kind != C_TYPE_KIND_TYPEDEF) {
+		return NULL;
+	}
+	return target;
+}
+
+// Typedef chains form a union-find forest, where every pure alias is
+// linked to the typedef it refers to. Links are made lazily, since the
+// aliased typedef may come later or from another header, and the paths
+// are compressed on every query, so the repeated lookups are amortized O(1).
+// Returns the last typedef in the chain: it aliases either a non-typedef
+// type (e.g. "int" or "struct S1"), or is a pointer/array derived type.
+CType *c_parser_resolve_typedef(CParserState *state, CType *type) {
+	rz_return_val_if_fail(state && type, NULL);
+	if (type->kind != C_TYPE_KIND_TYPEDEF) {
+		return type;
+	}
+	ut32 epoch = ++state->resolve_epoch;
+	CType *root = type;
+	root->mark = epoch;
+	for (;;) {
+		CType *next = root->parent;
+		if (!next) {
+			next = typedef_target(state, root);
+			if (!next) {
+				break;
+			}
+		}
+		if (next->mark == epoch) {
+			// "typedef A B; typedef B A;" cycles stay unresolved
+			break;
+		}
+		root->parent = next;
+		root = next;
+		root->mark = epoch;
+	}
+	// Path compression
+	while (type != root) {
+		CType *next = type->parent;
+		type->parent = root;
+		type = next;
+	}
+	return root;
+}
+
+// Returns the name of the type the typedef chain ends with,
+// e.g. "int" for "jint", or the name itself if it's not a typedef
+const char *c_parser_canonical_type(CParserState *state, const char *name) {
+	rz_return_val_if_fail(state && name, NULL);
+	CType *type = ht_pp_find(state->types, name, NULL);
+	if (!type || type->kind != C_TYPE_KIND_TYPEDEF) {
+		return name;
+	}
+	CType *root = c_parser_resolve_typedef(state, type);
+	if (!typedef_is_alias(root)) {
+		return root->name;
+	}
+	CTypeMember *member = rz_vector_index_ptr(&root->members, 0);
+	return member->type;
+}
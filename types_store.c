@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include <rz_types.h>
+#include <rz_vector.h>
+#include <rz_th.h>
+#include <rz_util/rz_assert.h>
+
+#include <types_store.h>
+
+// Tables are grown at half load, so the probing
+// always ends at an empty slot
+#define STORE_TABLE_MIN 64
+
+typedef struct {
+	_Atomic(ut64) hash; // Key hash, 0 for an empty slot, published last
+	char *key; // e.g. "struct S1", shared by the tables of the shard
+	_Atomic(CType *) type;
+} StoreSlot;
+
+typedef struct {
+	ut32 mask;
+	ut32 count; // Used slots, only changed under the shard lock
+	StoreSlot slots[];
+} StoreTable;
+
+typedef struct {
+	RzThreadLock *lock; // Serializes the publications
+	_Atomic(StoreTable *) table;
+} StoreShard;
+
+typedef struct {
+	_Atomic(ut64) epoch; // Global epoch the reader entered in, 0 if outside
+	ut8 pad[64 - sizeof(ut64)]; // Every reader writes only its own cache line
+} StoreReader;
+
+typedef struct {
+	void *ptr;
+	void (*free)(void *ptr);
+	ut64 epoch; // Global epoch the replacement was made in
+} StoreRetired;
+
+// Worker side copy of a type waiting for the publication
+typedef struct {
+	char *key;
+	ut64 hash;
+	CType *type;
+} StoreEntry;
+
+struct c_type_store_t {
+	StoreShard shards[C_TYPE_STORE_SHARDS];
+	StoreReader readers[C_TYPE_STORE_READERS];
+	_Atomic(ut32) readers_count;
+	_Atomic(ut64) epoch;
+	RzThreadLock *retired_lock;
+	RzVector /*<StoreRetired>*/ retired;
+	_Atomic(ut64) types;
+	_Atomic(ut64) merged;
+	_Atomic(ut64) conflicts;
+	_Atomic(ut64) batches;
+	_Atomic(ut64) resizes;
+	_Atomic(ut64) reclaimed;
+};
+
+struct c_type_store_batch_t {
+	CTypeStore *store;
+	RzVector /*<StoreEntry>*/ shards[C_TYPE_STORE_SHARDS];
+	ut32 count;
+};
+
+// The top bits pick the shard and the bottom ones the slot,
+// 0 marks the empty slots
+static ut64 key_hash(const char *key) {
+	ut64 hash = c_type_key_hash(key);
+	return hash ? hash : 1;
+}
+
+static StoreShard *key_shard(CTypeStore *store, ut64 hash) {
+	return &store->shards[hash >> (64 - C_TYPE_STORE_SHARD_BITS)];
+}
+
+static StoreTable *table_new(ut32 size) {
+	StoreTable *table = calloc(1, sizeof(StoreTable) + size * sizeof(StoreSlot));
+	if (!table) {
+		return NULL;
+	}
+	table->mask = size - 1;
+	return table;
+}
+
+static StoreSlot *table_find(StoreTable *table, ut64 hash, const char *key) {
+	ut32 i = hash & table->mask;
+	for (;; i = (i + 1) & table->mask) {
+		StoreSlot *slot = &table->slots[i];
+		ut64 stored = atomic_load_explicit(&slot->hash, memory_order_acquire);
+		if (!stored) {
+			return NULL;
+		}
+		if (stored == hash && !strcmp(slot->key, key)) {
+			return slot;
+		}
+	}
+}
+
+static StoreSlot *table_empty_slot(StoreTable *table, ut64 hash) {
+	ut32 i = hash & table->mask;
+	while (atomic_load_explicit(&table->slots[i].hash, memory_order_relaxed)) {
+		i = (i + 1) & table->mask;
+	}
+	return &table->slots[i];
+}
+
+static void table_free_all(StoreTable *table) {
+	ut32 i;
+	for (i = 0; i <= table->mask; i++) {
+		StoreSlot *slot = &table->slots[i];
+		if (atomic_load_explicit(&slot->hash, memory_order_relaxed)) {
+			free(slot->key);
+			c_type_free(atomic_load_explicit(&slot->type, memory_order_relaxed));
+		}
+	}
+	free(table);
+}
+
+CTypeStore *c_type_store_new(void) {
+	CTypeStore *store = RZ_NEW0(CTypeStore);
+	if (!store) {
+		return NULL;
+	}
+	atomic_init(&store->epoch, 1);
+	rz_vector_init(&store->retired, sizeof(StoreRetired), NULL, NULL);
+	store->retired_lock = rz_th_lock_new(false);
+	if (!store->retired_lock) {
+		c_type_store_free(store);
+		return NULL;
+	}
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS; i++) {
+		StoreShard *shard = &store->shards[i];
+		shard->lock = rz_th_lock_new(false);
+		StoreTable *table = table_new(STORE_TABLE_MIN);
+		atomic_init(&shard->table, table);
+		if (!shard->lock || !table) {
+			c_type_store_free(store);
+			return NULL;
+		}
+	}
+	return store;
+}
+
+// No readers or publishers may be active
+void c_type_store_free(CTypeStore *store) {
+	if (!store) {
+		return;
+	}
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS; i++) {
+		StoreShard *shard = &store->shards[i];
+		StoreTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+		if (table) {
+			table_free_all(table);
+		}
+		rz_th_lock_free(shard->lock);
+	}
+	StoreRetired *retired;
+	rz_vector_foreach(&store->retired, retired) {
+		retired->free(retired->ptr);
+	}
+	rz_vector_fini(&store->retired);
+	rz_th_lock_free(store->retired_lock);
+	free(store);
+}
+
+void c_type_store_stats(CTypeStore *store, CTypeStoreStats *stats) {
+	rz_return_if_fail(store && stats);
+	stats->types = atomic_load(&store->types);
+	stats->merged = atomic_load(&store->merged);
+	stats->conflicts = atomic_load(&store->conflicts);
+	stats->batches = atomic_load(&store->batches);
+	stats->resizes = atomic_load(&store->resizes);
+	stats->reclaimed = atomic_load(&store->reclaimed);
+}
+
+// Returns the reader id, -1 if all the readers are taken
+int c_type_store_reader(CTypeStore *store) {
+	rz_return_val_if_fail(store, -1);
+	ut32 id = atomic_fetch_add(&store->readers_count, 1);
+	return id < C_TYPE_STORE_READERS ? (int)id : -1;
+}
+
+// The fence orders the announcement before the reads, it pairs with the
+// one in store_retire(), so a reclaiming publisher either sees the reader
+// or the reader sees the replacement
+void c_type_store_enter(CTypeStore *store, int reader) {
+	rz_return_if_fail(store && reader >= 0 && reader < C_TYPE_STORE_READERS);
+	ut64 epoch = atomic_load_explicit(&store->epoch, memory_order_relaxed);
+	atomic_store_explicit(&store->readers[reader].epoch, epoch, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+void c_type_store_leave(CTypeStore *store, int reader) {
+	rz_return_if_fail(store && reader >= 0 && reader < C_TYPE_STORE_READERS);
+	atomic_store_explicit(&store->readers[reader].epoch, 0, memory_order_release);
+}
+
+// Lock-free lookup by the full name, e.g. "struct S1" or "jint".
+// Only valid between c_type_store_enter() and c_type_store_leave()
+CType *c_type_store_find(CTypeStore *store, const char *name) {
+	rz_return_val_if_fail(store && name, NULL);
+	ut64 hash = key_hash(name);
+	StoreShard *shard = key_shard(store, hash);
+	StoreTable *table = atomic_load_explicit(&shard->table, memory_order_acquire);
+	StoreSlot *slot = table_find(table, hash, name);
+	return slot ? atomic_load_explicit(&slot->type, memory_order_acquire) : NULL;
+}
+
+// Frees the retired entries no reader can see anymore: the ones retired
+// before the oldest epoch any of the active readers entered in
+static void store_reclaim(CTypeStore *store) {
+	ut64 oldest = UT64_MAX;
+	ut32 count = RZ_MIN(atomic_load(&store->readers_count), C_TYPE_STORE_READERS);
+	ut32 i;
+	for (i = 0; i < count; i++) {
+		ut64 epoch = atomic_load(&store->readers[i].epoch);
+		if (epoch && epoch < oldest) {
+			oldest = epoch;
+		}
+	}
+	StoreRetired *entries = rz_vector_head(&store->retired);
+	size_t len = rz_vector_len(&store->retired);
+	size_t kept = 0;
+	for (i = 0; i < len; i++) {
+		if (entries[i].epoch < oldest) {
+			entries[i].free(entries[i].ptr);
+			atomic_fetch_add_explicit(&store->reclaimed, 1, memory_order_relaxed);
+		} else {
+			entries[kept++] = entries[i];
+		}
+	}
+	store->retired.len = kept;
+}
+
+// Called once the replacement is published
+static void store_retire(CTypeStore *store, void *ptr, void (*free_fn)(void *)) {
+	atomic_thread_fence(memory_order_seq_cst);
+	StoreRetired retired = {
+		.ptr = ptr,
+		.free = free_fn,
+		.epoch = atomic_fetch_add(&store->epoch, 1),
+	};
+	rz_th_lock_enter(store->retired_lock);
+	if (!rz_vector_push(&store->retired, &retired)) {
+		// Leaked rather than freed under a reader
+		eprintf("Cannot retire a type store record\n");
+	}
+	store_reclaim(store);
+	rz_th_lock_leave(store->retired_lock);
+}
+
+static void type_free(void *ptr) {
+	c_type_free(ptr);
+}
+
+// The readers keep probing the old table, thus the
+// new one is filled before it gets published
+static StoreTable *shard_grow(CTypeStore *store, StoreShard *shard, StoreTable *old) {
+	StoreTable *table = table_new((old->mask + 1) * 2);
+	if (!table) {
+		return NULL;
+	}
+	ut32 i;
+	for (i = 0; i <= old->mask; i++) {
+		StoreSlot *from = &old->slots[i];
+		ut64 hash = atomic_load_explicit(&from->hash, memory_order_relaxed);
+		if (!hash) {
+			continue;
+		}
+		StoreSlot *to = table_empty_slot(table, hash);
+		to->key = from->key;
+		atomic_init(&to->type, atomic_load_explicit(&from->type, memory_order_relaxed));
+		atomic_init(&to->hash, hash);
+	}
+	table->count = old->count;
+	atomic_store_explicit(&shard->table, table, memory_order_release);
+	atomic_fetch_add_explicit(&store->resizes, 1, memory_order_relaxed);
+	store_retire(store, old, free);
+	return table;
+}
+
+// Same rules as c_parser_store_type(), the first definition wins. Takes
+// the ownership of the entry, called with the shard lock held
+static void shard_publish(CTypeStore *store, StoreShard *shard, StoreEntry *entry) {
+	StoreTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+	CType *type = entry->type;
+	StoreSlot *slot = table_find(table, entry->hash, entry->key);
+	if (!slot) {
+		if ((table->count + 1) * 2 > table->mask + 1) {
+			table = shard_grow(store, shard, table);
+			if (!table) {
+				free(entry->key);
+				c_type_free(type);
+				return;
+			}
+		}
+		slot = table_empty_slot(table, entry->hash);
+		slot->key = entry->key;
+		atomic_store_explicit(&slot->type, type, memory_order_relaxed);
+		atomic_store_explicit(&slot->hash, entry->hash, memory_order_release);
+		table->count++;
+		atomic_fetch_add_explicit(&store->types, 1, memory_order_relaxed);
+		return;
+	}
+	CType *stored = atomic_load_explicit(&slot->type, memory_order_relaxed);
+	if (type->forward) {
+		// Declaring an already known type changes nothing
+		c_type_free(type);
+	} else if (stored->forward) {
+		// Readers may be using the forward declaration,
+		// so it's replaced rather than completed in place
+		atomic_store_explicit(&slot->type, type, memory_order_release);
+		store_retire(store, stored, type_free);
+	} else if (c_type_equal(stored, type)) {
+		atomic_fetch_add_explicit(&store->merged, 1, memory_order_relaxed);
+		c_type_free(type);
+	} else {
+		eprintf("ERROR: Conflicting redefinition of %s, keeping the first one\n", entry->key);
+		atomic_fetch_add_explicit(&store->conflicts, 1, memory_order_relaxed);
+		c_type_free(type);
+	}
+	free(entry->key);
+}
+
+CTypeStoreBatch *c_type_store_batch_new(CTypeStore *store) {
+	rz_return_val_if_fail(store, NULL);
+	CTypeStoreBatch *batch = RZ_NEW0(CTypeStoreBatch);
+	if (!batch) {
+		return NULL;
+	}
+	batch->store = store;
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS; i++) {
+		rz_vector_init(&batch->shards[i], sizeof(StoreEntry), NULL, NULL);
+	}
+	return batch;
+}
+
+// Unpublished types are dropped, see c_type_store_batch_flush()
+void c_type_store_batch_free(CTypeStoreBatch *batch) {
+	if (!batch) {
+		return;
+	}
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS; i++) {
+		StoreEntry *entry;
+		rz_vector_foreach(&batch->shards[i], entry) {
+			free(entry->key);
+			c_type_free(entry->type);
+		}
+		rz_vector_fini(&batch->shards[i]);
+	}
+	free(batch);
+}
+
+// Takes the ownership of the type, the batch is published once full
+bool c_type_store_batch_add(CTypeStoreBatch *batch, CType *type) {
+	rz_return_val_if_fail(batch && type && type->name, false);
+	StoreEntry entry = { .key = c_type_key(type->kind, type->name), .type = type };
+	if (!entry.key) {
+		c_type_free(type);
+		return false;
+	}
+	entry.hash = key_hash(entry.key);
+	int shard = entry.hash >> (64 - C_TYPE_STORE_SHARD_BITS);
+	if (!rz_vector_push(&batch->shards[shard], &entry)) {
+		free(entry.key);
+		c_type_free(type);
+		return false;
+	}
+	if (++batch->count >= C_TYPE_STORE_BATCH) {
+		c_type_store_batch_flush(batch);
+	}
+	return true;
+}
+
+void c_type_store_batch_flush(CTypeStoreBatch *batch) {
+	rz_return_if_fail(batch);
+	CTypeStore *store = batch->store;
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS && batch->count; i++) {
+		RzVector *entries = &batch->shards[i];
+		if (rz_vector_empty(entries)) {
+			continue;
+		}
+		StoreShard *shard = &store->shards[i];
+		rz_th_lock_enter(shard->lock);
+		StoreEntry *entry;
+		rz_vector_foreach(entries, entry) {
+			shard_publish(store, shard, entry);
+		}
+		rz_th_lock_leave(shard->lock);
+		atomic_fetch_add_explicit(&store->batches, 1, memory_order_relaxed);
+		batch->count -= rz_vector_len(entries);
+		rz_vector_clear(entries);
+	}
+}
+
+// Moves all the stored types out of the store, which is left empty.
+// No readers or publishers may be active
+bool c_type_store_take(CTypeStore *store, RzPVector /*<CType *>*/ *out) {
+	rz_return_val_if_fail(store && out, false);
+	int i;
+	for (i = 0; i < C_TYPE_STORE_SHARDS; i++) {
+		StoreShard *shard = &store->shards[i];
+		StoreTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+		StoreTable *empty = table_new(STORE_TABLE_MIN);
+		if (!empty) {
+			return false;
+		}
+		ut32 j;
+		for (j = 0; j <= table->mask; j++) {
+			StoreSlot *slot = &table->slots[j];
+			if (!atomic_load_explicit(&slot->hash, memory_order_relaxed)) {
+				continue;
+			}
+			free(slot->key);
+			rz_pvector_push(out, atomic_load_explicit(&slot->type, memory_order_relaxed));
+		}
+		free(table);
+		atomic_store_explicit(&shard->table, empty, memory_order_relaxed);
+	}
+	atomic_store(&store->types, 0);
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef TYPES_STORE_H
+#define TYPES_STORE_H
+
+#include <rz_types.h>
+#include <rz_vector.h>
+
+#include <types_parser.h>
+
+// Type store shared by the parallel workers. The lookups take no locks,
+// the readers only announce the epoch they entered in. The workers collect
+// the types into batches, which are published shard by shard, so a batch
+// takes every shard lock it needs once. The published records are never
+// modified: a completed forward declaration replaces the stored record,
+// and the replaced records and tables are reclaimed once no reader
+// entered before the replacement is left.
+
+#define C_TYPE_STORE_SHARD_BITS 6
+#define C_TYPE_STORE_SHARDS (1 << C_TYPE_STORE_SHARD_BITS)
+#define C_TYPE_STORE_READERS 256 // Registered readers, e.g. the parallel workers
+#define C_TYPE_STORE_BATCH 256 // Types collected by a worker before the publication
+
+typedef struct c_type_store_t CTypeStore;
+typedef struct c_type_store_batch_t CTypeStoreBatch;
+
+typedef struct {
+	ut64 types; // Distinct types stored
+	ut64 merged; // Identical redefinitions published by the workers
+	ut64 conflicts;
+	ut64 batches; // Shard parts of the batches, one lock taken each
+	ut64 resizes;
+	ut64 reclaimed; // Replaced tables and records freed
+} CTypeStoreStats;
+
+CTypeStore *c_type_store_new(void);
+void c_type_store_free(CTypeStore *store);
+void c_type_store_stats(CTypeStore *store, CTypeStoreStats *stats);
+
+// Readers, the found records are valid until the reader leaves
+int c_type_store_reader(CTypeStore *store);
+void c_type_store_enter(CTypeStore *store, int reader);
+void c_type_store_leave(CTypeStore *store, int reader);
+CType *c_type_store_find(CTypeStore *store, const char *name);
+
+// Publication, every worker uses its own batch
+CTypeStoreBatch *c_type_store_batch_new(CTypeStore *store);
+void c_type_store_batch_free(CTypeStoreBatch *batch);
+bool c_type_store_batch_add(CTypeStoreBatch *batch, CType *type);
+void c_type_store_batch_flush(CTypeStoreBatch *batch);
+
+bool c_type_store_take(CTypeStore *store, RzPVector /*<CType *>*/ *out);
+
+#endif